@@ -25,312 +25,5203 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
+#include <span>
+#include <string_view>
+#include <cstddef>
 #include <cmath>
 #include <numeric>
-#include <cctype> // for std::tolower
+#include <cctype> // for std::isprint
+#include <cstdint>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <optional>
+#include <filesystem>
+#include <system_error>
+#include <concepts>
+#include <ranges>
+#include <type_traits>
+#include <functional>
+#include <iterator>
+#include <cstdio>
+#include <complex>
+#include <cstring>
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define BYTE_VAL_COUNT 256
+#define LZ_BLOCK_SIZE (1 << 20)
+#define LZ_WINDOW_SIZE (1 << 16)
+#define LZ_HASH_BITS 16
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_CHAIN 32
+#define SCAN_CHUNK_SIZE (64 << 20)
+#define GENERATOR_CHUNK_SIZE (1 << 20)
+#define STREAM_BLOCK_SIZE (64 << 10)
+#define HEALTH_FALSE_ALARM_BITS 20  // SP 800-90B false positive probability 2^-20
+#define HEALTH_APT_WINDOW 512
+#define AUTOCORRELATION_MIN_FFT (1 << 12)
+#define AUTOCORRELATION_STRONGEST 5
+#define SPECTRAL_PEAK_FRACTION 0.95  // Share of DFT peaks expected below the threshold
+#define SPECTRAL_ALPHA 0.01          // Significance level of the per-block pass rate
+#define SPECTRAL_P_BINS 10
+#define RANK_GROUP_SIZE 512  // Bytes of one 64 x 64 matrix, or four 32 x 32 matrices
+#define LINEAR_COMPLEXITY_CLASSES 7
+#define LINEAR_COMPLEXITY_MAX_BLOCK (1 << 16)
+#define UNIVERSAL_MIN_BLOCK 6
+#define UNIVERSAL_MAX_BLOCK 16
+#define PATTERN_MAX_LENGTH 16
+#define RADIX_BITS 11
+#define SYMBOL_DENSE_BITS 16  // Widest symbols counted in a dense histogram, wider ones are sorted
+#define COLUMN_MAX_RECORD 4096  // Largest record size of the column statistics
+#define TRANSFORM_MAX_LAG 4096  // Furthest predecessor of the XOR-with-lag transform
+#define POKER_HAND 5          // Symbols per poker hand
+#define GAP_LIMIT 32          // Gaps of this many symbols or more share a class
+#define MIN_CLASS_EXPECTED 5.0  // Chi-square classes are merged until each expects this many
 
 namespace Ent {
 
-class Ent {
+// Tests that can be selected at compile time through Options, and among those at run
+// time with setTestMask() and setTestMode()
+enum Tests : unsigned {
+    TEST_ENTROPY = 1u << 0,
+    TEST_CHISQUARE = 1u << 1,
+    TEST_MEAN = 1u << 2,
+    TEST_PI = 1u << 3,
+    TEST_SERIAL_CORRELATION = 1u << 4,
+    TEST_LZ = 1u << 5,  // Size after a fast LZ-style compressor, from the data in memory
+    TEST_BIT_BATTERY = 1u << 6,  // SP 800-22 frequency, block frequency, runs, longest run and cumulative sums
+    TEST_AUTOCORRELATION = 1u << 7,  // Correlation of bytes at every distance up to the set number of lags
+    TEST_SPECTRAL = 1u << 8,  // SP 800-22 DFT spectral test over blocks of the bit stream
+    TEST_MATRIX_RANK = 1u << 9,  // SP 800-22 binary matrix rank on 32 x 32 and 64 x 64 matrices
+    TEST_LINEAR_COMPLEXITY = 1u << 10,  // SP 800-22 linear complexity, Berlekamp-Massey over blocks
+    TEST_UNIVERSAL = 1u << 11,  // SP 800-22 Maurer's universal statistical test
+    TEST_PATTERNS = 1u << 12,  // SP 800-22 serial and approximate entropy for every pattern length
+    TEST_BIRTHDAY = 1u << 13,  // Birthday spacings on 32-bit or 64-bit samples
+    TEST_KNUTH = 1u << 14,  // Knuth's poker, gap and coupon collector tests
+    TEST_BIT_POSITIONS = 1u << 15,  // Ones fraction, chi-square and lag-1 correlation of every bit position
+    TEST_COLUMNS = 1u << 16,  // Entropy, chi-square and mean of each byte offset within records
+    TEST_FLOAT_FIELDS = 1u << 17,  // Entropy of the sign, exponent and mantissa of IEEE 754 values
+    TEST_TRANSFORMS = 1u << 18,  // Statistics of the byte delta and of the XOR with earlier bytes
+    TEST_ALL = TEST_ENTROPY | TEST_CHISQUARE | TEST_MEAN | TEST_PI | TEST_SERIAL_CORRELATION | TEST_LZ | TEST_BIT_BATTERY | TEST_AUTOCORRELATION | TEST_SPECTRAL | TEST_MATRIX_RANK | TEST_LINEAR_COMPLEXITY | TEST_UNIVERSAL | TEST_PATTERNS | TEST_BIRTHDAY | TEST_KNUTH | TEST_BIT_POSITIONS | TEST_COLUMNS | TEST_FLOAT_FIELDS | TEST_TRANSFORMS
+};
+
+// Tests that calculate() runs unless setTestMask() says otherwise
+#define DEFAULT_TEST_MASK (TEST_ENTROPY | TEST_CHISQUARE | TEST_MEAN | TEST_PI | TEST_SERIAL_CORRELATION)
+
+// Runtime keeps setStreamOfBitsMode(), Bytes and Bits fix the sample size at compile time
+enum class Sampling {
+    Runtime,
+    Bytes,
+    Bits
+};
+
+// Order of the bits that make up a symbol: Big takes the most significant bit of each byte
+// first, so whole-byte symbols read as big endian; Little takes the least significant first.
+enum class Endian {
+    Big,
+    Little
+};
+
+// Policy for BasicEnt. Tests left out of TestSet are compiled out of calculate() entirely.
+// Entropy, chi-square, mean and serial correlation are over symbols of SymbolBits bits.
+template <unsigned TestSet = TEST_ALL, Sampling SampleMode = Sampling::Runtime, unsigned SymbolBits = 8, Endian SymbolOrder = Endian::Big>
+struct Options {
+    static_assert(SymbolBits >= 1 && SymbolBits <= 32, "symbols are 1 to 32 bits wide");
+    static_assert(SymbolBits == 8 || SampleMode != Sampling::Bits, "bit sampling reads bytes as bits");
+    static constexpr unsigned tests = TestSet;
+    static constexpr Sampling sampling = SampleMode;
+    static constexpr unsigned symbolBits = SymbolBits;
+    static constexpr Endian symbolOrder = SymbolOrder;
+};
+
+// ASCII upper case letters map to lower case, as std::tolower does in the "C" locale
+inline const std::array<unsigned char, BYTE_VAL_COUNT> &fold_table() {
+    static const std::array<unsigned char, BYTE_VAL_COUNT> table = [] {
+        std::array<unsigned char, BYTE_VAL_COUNT> folded{};
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            folded[value] = (value >= 'A' && value <= 'Z') ? value - 'A' + 'a' : value;
+        }
+        return folded;
+    }();
+    return table;
+}
+
+// Byte translations applied inside the accumulation kernels, so folding never needs a
+// translated copy of the input
+struct SameByte {
+    unsigned char operator()(unsigned char byte) const {
+        return byte;
+    }
+};
+
+struct FoldedByte {
+    unsigned char operator()(unsigned char byte) const {
+        return fold_table()[byte];
+    }
+};
+
+// A generator is called for unsigned words, or is a range of unsigned words
+template <typename G>
+concept WordGenerator = requires(G generator) {
+    { generator() } -> std::unsigned_integral;
+};
+
+template <typename R>
+concept WordRange = std::ranges::input_range<R> && std::unsigned_integral<std::ranges::range_value_t<R>>;
+
+// Output bytes per word. Engines such as std::mt19937 declare their range with max(),
+// only whole bytes inside it are used; other generators contribute every byte of the word.
+template <typename G, typename Word>
+constexpr int generator_word_bytes() {
+    if constexpr (requires { { G::max() } -> std::convertible_to<Word>; }) {
+        return std::max(1, int(std::bit_width(static_cast<std::make_unsigned_t<Word>>(G::max()))) / 8);
+    } else {
+        return sizeof(Word);
+    }
+}
+
+// Fills out with little-endian words from generator and returns size; a word generator
+// never runs out, unlike the ranges of RangeCursor::generate()
+template <WordGenerator G>
+size_t generate_bytes(G &generator, unsigned char *out, size_t size) {
+    using Word = decltype(generator());
+    constexpr int wordBytes = generator_word_bytes<G, Word>();
+    size_t i = 0;
+    for (; i + wordBytes <= size; i += wordBytes) {
+        Word word = generator();
+        for (int k = 0; k < wordBytes; ++k) {
+            out[i + k] = static_cast<unsigned char>(word >> (8 * k));
+        }
+    }
+    if (i < size) {
+        Word word = generator();
+        for (int k = 0; i < size; ++i, ++k) {
+            out[i] = static_cast<unsigned char>(word >> (8 * k));
+        }
+    }
+    return size;
+}
+
+// Keeps the position in a range between calls
+template <WordRange R>
+class RangeCursor {
 private:
-    std::vector<unsigned char> data;
-    double entropy;
-    double compression;
-    double chisquare;
+    R &range;
+    std::ranges::iterator_t<R> position;
+
+public:
+    RangeCursor(R &range) : range(range), position(std::ranges::begin(range)) {
+    }
+
+    // Fills out like generate_bytes(), returns the number of bytes written, which is less
+    // than size only if the range runs out
+    size_t generate(unsigned char *out, size_t size) {
+        using Word = std::ranges::range_value_t<R>;
+        size_t i = 0;
+        while (i < size && position != std::ranges::end(range)) {
+            Word word = *position;
+            ++position;
+            for (size_t k = 0; k < sizeof(Word) && i < size; ++k, ++i) {
+                out[i] = static_cast<unsigned char>(word >> (8 * k));
+            }
+        }
+        return i;
+    }
+};
+
+// Offset and length of the regions of a file of size bytes that hold data, in order. The
+// gaps between them are holes that read as zeros. Without SEEK_DATA and SEEK_HOLE support
+// the whole file is one region.
+inline std::vector<std::pair<uint64_t, uint64_t>> data_extents(const std::string &path, uint64_t size) {
+    std::vector<std::pair<uint64_t, uint64_t>> extents;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        uint64_t position = 0;
+        bool supported = true;
+        while (position < size) {
+            off_t data = ::lseek(fd, off_t(position), SEEK_DATA);
+            if (data < 0) {
+                // ENXIO: only a hole is left up to the end of the file
+                supported = errno == ENXIO;
+                break;
+            }
+            off_t hole = ::lseek(fd, data, SEEK_HOLE);
+            if (hole < 0) {
+                supported = false;
+                break;
+            }
+            uint64_t end = std::min<uint64_t>(uint64_t(hole), size);
+            if (uint64_t(data) >= end) {
+                break;
+            }
+            extents.emplace_back(uint64_t(data), end - uint64_t(data));
+            position = end;
+        }
+        ::close(fd);
+        if (supported) {
+            return extents;
+        }
+        extents.clear();
+    }
+#endif
+    if (size > 0) {
+        extents.emplace_back(0, size);
+    }
+    return extents;
+}
+
+// Replaces the file at path with contents by renaming the file temporary, written first,
+// over it, so a reader opening path sees either the old or the new contents in full. With
+// sync the temporary is synced to disk before the rename and the rename is synced through
+// the directory, so a crash or power loss cannot leave a partial file either. Without
+// POSIX descriptors only the stream is flushed before the rename.
+inline bool replace_file(const std::string &path, std::string_view contents, const std::string &temporary, bool sync = true) {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = true;
+    for (size_t done = 0; written && done < contents.size();) {
+        ssize_t count = ::write(fd, contents.data() + done, contents.size() - done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        written = count > 0;
+        done += written ? size_t(count) : 0;
+    }
+    written = written && (!sync || ::fsync(fd) == 0);
+    written = ::close(fd) == 0 && written;
+    if (!written || ::rename(temporary.c_str(), path.c_str()) != 0) {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+    if (!sync) {
+        return true;
+    }
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    int directoryFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+    if (directoryFd < 0) {
+        return false;
+    }
+    // Some file systems cannot sync directories and report EINVAL
+    bool synced = ::fsync(directoryFd) == 0 || errno == EINVAL;
+    ::close(directoryFd);
+    return synced;
+#else
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size());
+        out.flush();
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+#endif
+}
+
+inline bool replace_file(const std::string &path, std::string_view contents) {
+    return replace_file(path, contents, path + ".tmp");
+}
+
+// Little-endian fixed width fields of serialized states
+inline void write_u64(std::ostream &out, uint64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<unsigned char>(value >> (8 * i));
+    }
+    out.write(reinterpret_cast<const char *>(bytes), 8);
+}
+
+inline uint64_t read_u64(std::istream &in) {
+    unsigned char bytes[8] = {};
+    in.read(reinterpret_cast<char *>(bytes), 8);
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= uint64_t(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+// Regularized upper incomplete gamma function Q(a, x), the p-value of a chi-square
+// statistic 2x with 2a degrees of freedom
+inline double igamc(double a, double x) {
+    if (x <= 0.0 || a <= 0.0) {
+        return 1.0;
+    }
+    double logPrefix = a * std::log(x) - x - std::lgamma(a);
+    if (x < a + 1.0) {
+        // Series for the lower function P(a, x)
+        double term = 1.0 / a;
+        double sum = term;
+        for (int n = 1; n < 100000; ++n) {
+            term *= x / (a + n);
+            sum += term;
+            if (std::fabs(term) < std::fabs(sum) * 1e-15) {
+                break;
+            }
+        }
+        return std::max(0.0, 1.0 - sum * std::exp(logPrefix));
+    }
+    // Continued fraction for Q(a, x), modified Lentz's method
+    const double tiny = 1e-300;
+    double b = x + 1.0 - a;
+    double c = 1.0 / tiny;
+    double d = 1.0 / b;
+    double h = d;
+    for (int i = 1; i < 100000; ++i) {
+        double an = -i * (i - a);
+        b += 2.0;
+        d = an * d + b;
+        if (std::fabs(d) < tiny) {
+            d = tiny;
+        }
+        c = b + an / c;
+        if (std::fabs(c) < tiny) {
+            c = tiny;
+        }
+        d = 1.0 / d;
+        double delta = d * c;
+        h *= delta;
+        if (std::fabs(delta - 1.0) < 1e-15) {
+            break;
+        }
+    }
+    return std::exp(logPrefix) * h;
+}
+
+inline double chisquare_p(double chisquare, double degreesOfFreedom) {
+    return igamc(degreesOfFreedom / 2.0, chisquare / 2.0);
+}
+
+inline double normal_cdf(double x) {
+    return 0.5 * std::erfc(-x * M_SQRT1_2);
+}
+
+// Chi-square of observed class counts against class probabilities, merging neighbouring
+// classes from the left until each expects MIN_CLASS_EXPECTED. Sets NaN with fewer than two
+// classes left.
+inline void lumped_chisquare(const std::vector<uint64_t> &observed, const std::vector<double> &probability, double &chisquare, double &p) {
+    double total = double(std::accumulate(observed.begin(), observed.end(), uint64_t(0)));
+    std::vector<std::pair<double, double>> classes;  // Observed, expected
+    double groupObserved = 0.0, groupExpected = 0.0;
+    for (size_t c = 0; c < observed.size(); ++c) {
+        groupObserved += double(observed[c]);
+        groupExpected += probability[c] * total;
+        if (groupExpected >= MIN_CLASS_EXPECTED) {
+            classes.push_back({groupObserved, groupExpected});
+            groupObserved = groupExpected = 0.0;
+        }
+    }
+    if (!classes.empty()) {
+        classes.back().first += groupObserved;
+        classes.back().second += groupExpected;
+    }
+    chisquare = p = std::nan("");
+    if (classes.size() < 2) {
+        return;
+    }
+    chisquare = 0.0;
+    for (const auto &[count, expected] : classes) {
+        chisquare += (count - expected) * (count - expected) / expected;
+    }
+    p = chisquare_p(chisquare, double(classes.size() - 1));
+}
+
+// Iterative radix-2 FFT of one power of two size. The twiddle factors of each stage are
+// stored contiguously, so every butterfly pass reads them sequentially.
+class Fft {
+private:
+    size_t size;
+    std::vector<std::complex<double>> twiddles;  // Stage of span 2h at [h - 1, 2h - 1)
+    std::vector<uint32_t> reversed;
+
+public:
+    Fft(size_t size) : size(size), twiddles(size > 1 ? size - 1 : 0), reversed(size) {
+        for (size_t half = 1; half < size; half <<= 1) {
+            for (size_t k = 0; k < half; ++k) {
+                twiddles[half - 1 + k] = std::polar(1.0, -M_PI * double(k) / double(half));
+            }
+        }
+        int bits = std::countr_zero(size);
+        for (size_t i = 1; i < size; ++i) {
+            reversed[i] = uint32_t((reversed[i >> 1] >> 1) | ((i & 1) << (bits - 1)));
+        }
+    }
+
+    size_t get_size() const {
+        return size;
+    }
+
+    // In place transform of get_size() values, the inverse is not scaled by 1 / size
+    void transform(std::complex<double> *values, bool inverse = false) const {
+        for (size_t i = 0; i < size; ++i) {
+            if (i < reversed[i]) {
+                std::swap(values[i], values[reversed[i]]);
+            }
+        }
+        double sign = inverse ? -1.0 : 1.0;
+        for (size_t half = 1; half < size; half <<= 1) {
+            const std::complex<double> *stage = twiddles.data() + half - 1;
+            for (size_t start = 0; start < size; start += 2 * half) {
+                std::complex<double> *low = values + start;
+                std::complex<double> *high = low + half;
+                for (size_t k = 0; k < half; ++k) {
+                    // Written out to keep std::complex's NaN checks out of the inner loop
+                    double wr = stage[k].real();
+                    double wi = sign * stage[k].imag();
+                    double tr = wr * high[k].real() - wi * high[k].imag();
+                    double ti = wr * high[k].imag() + wi * high[k].real();
+                    high[k] = {low[k].real() - tr, low[k].imag() - ti};
+                    low[k] = {low[k].real() + tr, low[k].imag() + ti};
+                }
+            }
+        }
+    }
+};
+
+// DFT spectral test over blocks of the bit stream. The p-value combines the peak counts
+// of all blocks; the pass rate and the uniformity of the per-block p-values follow the
+// SP 800-22 second level assessment.
+struct SpectralResult {
+    uint64_t blocks;
+    uint32_t blockBits;
+    double statistic;   // Normalized excess of peaks below the threshold over all blocks
     double p_value;
-    double mean;
-    double pi_estimate;
-    double serial_correlation;
-    bool streamOfBitsMode;
-    bool printTableMode;
-    bool foldCaseMode;
-    bool terseMode;
-    bool printResultMode;
+    double passRate;    // Share of blocks with a p-value of at least SPECTRAL_ALPHA
+    double uniformity;  // p-value of the chi-square of the per-block p-values in SPECTRAL_P_BINS bins
+};
 
-    std::vector<unsigned char> load_file_data(const std::string &path) {
-        std::ifstream file(path, std::ios::binary);
-        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+// Results of the BitBattery tests, p-values are NaN when the input is too short
+struct BitBatteryResult {
+    uint64_t bits;
+    double frequency;
+    double blockFrequencyChisquare;
+    double blockFrequency;
+    double runs;
+    double longestRunChisquare;
+    double longestRun;
+    double cumulativeSumsForward;
+    double cumulativeSumsReverse;
+};
+
+// SP 800-22 frequency, block frequency, runs, longest run of ones and cumulative sums tests.
+// Bits are taken most significant first and processed as 64-bit words with popcount and
+// clz/ctz, the random walk of the cumulative sums test through per-byte tables.
+class BitBattery {
+private:
+    static constexpr int LONGEST_RUN_BLOCK = 128;
+    static constexpr int LONGEST_RUN_CLASSES = 6;  // Longest run <= 4, 5, 6, 7, 8, >= 9
+
+    uint32_t blockBits;  // Block frequency block size, a multiple of 64
+    uint64_t bits;
+    uint64_t ones;
+    uint64_t transitions;
+    bool started;
+    uint8_t firstBit;
+    uint8_t lastBit;
+    int64_t walk;
+    int64_t walkMin;
+    int64_t walkMax;
+    uint64_t frequencyBlocks;
+    uint64_t frequencySquares;  // Sum of (2 * ones - M)^2 over complete blocks
+    uint32_t blockWords;
+    uint64_t blockOnes;
+    std::array<uint64_t, LONGEST_RUN_CLASSES> runClasses;
+    uint32_t runWords;
+    uint32_t currentRun;
+    uint32_t blockLongest;
+    std::array<unsigned char, 8> pending;
+    uint8_t pendingLength;
+
+    struct WalkStep {
+        int8_t delta;
+        int8_t low;
+        int8_t high;
+    };
+
+    // Walk of the eight bits of a byte, most significant first: end point and extremes
+    static const std::array<WalkStep, BYTE_VAL_COUNT> &walk_table() {
+        static const std::array<WalkStep, BYTE_VAL_COUNT> table = [] {
+            std::array<WalkStep, BYTE_VAL_COUNT> steps{};
+            for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+                int position = 0, low = 0, high = 0;
+                for (int bit = 7; bit >= 0; --bit) {
+                    position += ((value >> bit) & 1) ? 1 : -1;
+                    low = std::min(low, position);
+                    high = std::max(high, position);
+                }
+                steps[value] = {int8_t(position), int8_t(low), int8_t(high)};
+            }
+            return steps;
+        }();
+        return table;
     }
 
-    void print_result() {
-        std::string samp = streamOfBitsMode ? "bit" : "byte";
-        std::cout << "Entropy = " + std::to_string(entropy) + " bits per " + samp + ".\n\n";
-        std::cout << "Optimum compression would reduce the size\nof this " + std::to_string(int(data.size()*(streamOfBitsMode ? 8.0 : 1.0))) + " " + samp + " file by " + std::to_string((int) ((100 * ((streamOfBitsMode ? 1 : 8) - entropy) / (streamOfBitsMode ? 1.0 : 8.0)))) + " percent.\n\n";
-        std::cout << "Chi square distribution for " + std::to_string(int(data.size()*(streamOfBitsMode ? 8.0 : 1.0))) + " samples is " + std::to_string(chisquare) + ", and randomly\n";
-        if (p_value < 0.0001) {
-            std::cout << "would exceed this value less than 0.01 percent of the times.\n\n";
-        } else if (p_value > 0.9999) {
-            std::cout << "would exceed this value more than than 99.99 percent of the times.\n\n";
+    static int longest_run(uint64_t word) {
+        int run = 0;
+        while (word) {
+            word &= word << 1;
+            run++;
+        }
+        return run;
+    }
+
+    void add_walk(unsigned char byte) {
+        const WalkStep &step = walk_table()[byte];
+        walkMin = std::min<int64_t>(walkMin, walk + step.low);
+        walkMax = std::max<int64_t>(walkMax, walk + step.high);
+        walk += step.delta;
+    }
+
+    void add_word(uint64_t word) {
+        uint8_t leading = uint8_t(word >> 63);
+        if (started) {
+            transitions += lastBit != leading;
         } else {
-            std::cout << "would exceed this value " + std::to_string(p_value * 100) + " percent of the times.\n\n";
+            firstBit = leading;
+            started = true;
+        }
+        transitions += std::popcount((word ^ (word >> 1)) & 0x7FFFFFFFFFFFFFFFull);
+        lastBit = uint8_t(word & 1);
+        int count = std::popcount(word);
+        ones += count;
+        bits += 64;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            add_walk(static_cast<unsigned char>(word >> shift));
+        }
+
+        blockOnes += count;
+        if (++blockWords == blockBits / 64) {
+            int64_t deviation = 2 * int64_t(blockOnes) - int64_t(blockBits);
+            frequencySquares += uint64_t(deviation * deviation);
+            frequencyBlocks++;
+            blockOnes = 0;
+            blockWords = 0;
         }
-        std::cout << "Arithmetic mean value of data bytes is " + std::to_string(mean) + " (" + std::to_string(streamOfBitsMode ? 0.5 : 127.5) + " = random).\n";
-        std::cout << "Monte Carlo value for Pi is " + std::to_string(pi_estimate) + " (error " + std::to_string(std::fabs(pi_estimate - M_PI) / M_PI * 100.0) + " percent).\n";
-        std::cout << "Serial correlation coefficient is ";
-        if (serial_correlation >= -99999) {
-            std::cout << std::to_string(serial_correlation) + " (totally uncorrelated = 0.0).\n";
+
+        // Runs of ones carry over from the previous word of the same block
+        int leadingOnes = std::countl_one(word);
+        if (leadingOnes == 64) {
+            currentRun += 64;
+            blockLongest = std::max(blockLongest, currentRun);
         } else {
-            std::cout << "undefined (all values equal!).\n";
+            blockLongest = std::max<uint32_t>({blockLongest, currentRun + leadingOnes, uint32_t(longest_run(word))});
+            currentRun = std::countr_one(word);
+        }
+        if (++runWords == LONGEST_RUN_BLOCK / 64) {
+            runClasses[std::clamp<int>(blockLongest, 4, 9) - 4]++;
+            runWords = 0;
+            currentRun = 0;
+            blockLongest = 0;
         }
     }
 
-    void print_table() {
-        if (streamOfBitsMode) {
-            std::vector<int> bitOccurrences(2, 0);
-    
-            // Iterate over each byte and then each bit within that byte
-            for (auto &byte : data) {
-                for(int bit=0; bit<8; bit++) {
-                    int bitValue = (byte >> bit) & 1;
-                    bitOccurrences[bitValue]++;
+    // Whole bytes left over at the end count for the tests that are not block based
+    void add_tail_byte(unsigned char byte) {
+        uint8_t leading = byte >> 7;
+        if (started) {
+            transitions += lastBit != leading;
+        } else {
+            firstBit = leading;
+            started = true;
+        }
+        transitions += std::popcount(unsigned((byte ^ (byte >> 1)) & 0x7F));
+        lastBit = byte & 1;
+        ones += std::popcount(unsigned(byte));
+        bits += 8;
+        add_walk(byte);
+    }
+
+    static double cumulative_sums_p(double z, double n) {
+        if (z <= 0.0) {
+            return 1.0;
+        }
+        double root = std::sqrt(n);
+        // Terms further out than 40 standard deviations vanish
+        double reach = std::ceil(10.0 * root / z) + 1.0;
+        auto bound = [reach](double k) { return std::clamp(k, -reach, reach); };
+        double sum1 = 0.0;
+        for (double k = bound(std::floor((-n / z + 1.0) / 4.0)); k <= bound(std::floor((n / z - 1.0) / 4.0)); ++k) {
+            sum1 += normal_cdf((4.0 * k + 1.0) * z / root) - normal_cdf((4.0 * k - 1.0) * z / root);
+        }
+        double sum2 = 0.0;
+        for (double k = bound(std::floor((-n / z - 3.0) / 4.0)); k <= bound(std::floor((n / z - 1.0) / 4.0)); ++k) {
+            sum2 += normal_cdf((4.0 * k + 3.0) * z / root) - normal_cdf((4.0 * k + 1.0) * z / root);
+        }
+        return std::clamp(1.0 - sum1 + sum2, 0.0, 1.0);
+    }
+
+public:
+    BitBattery(uint32_t blockBits = 128) : blockBits(std::max<uint32_t>(64, blockBits / 64 * 64)), bits(0), ones(0), transitions(0), started(false), firstBit(0), lastBit(0), walk(0), walkMin(0), walkMax(0), frequencyBlocks(0), frequencySquares(0), blockWords(0), blockOnes(0), runClasses{}, runWords(0), currentRun(0), blockLongest(0), pending{}, pendingLength(0) {
+    }
+
+    uint32_t get_block_bits() const {
+        return blockBits;
+    }
+
+    // Byte granularity at which two accumulations can be joined with merge()
+    size_t alignment() const {
+        return std::lcm<size_t>(LONGEST_RUN_BLOCK / 8, blockBits / 8);
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        size_t i = 0;
+        while (pendingLength > 0 && i < size) {
+            pending[pendingLength++] = map(bytes[i++]);
+            if (pendingLength == 8) {
+                uint64_t word = 0;
+                for (int k = 0; k < 8; ++k) {
+                    word = word << 8 | pending[k];
                 }
+                add_word(word);
+                pendingLength = 0;
             }
-    
-            // Print bit occurrences and fraction
-            for (int bitValue = 0; bitValue <= 1; ++bitValue) {
-                double fraction = bitOccurrences[bitValue] / static_cast<double>(data.size() * 8);
-                std::cout << "Value: " << bitValue << " Occurrences: " << bitOccurrences[bitValue] << " Fraction: " << fraction << "\n";
+        }
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word = 0;
+            for (int k = 0; k < 8; ++k) {
+                word = word << 8 | map(bytes[i + k]);
             }
+            add_word(word);
+        }
+        for (; i < size; ++i) {
+            pending[pendingLength++] = map(bytes[i]);
+        }
+    }
+
+    // Appends the accumulation of the bits directly following, both joined at alignment()
+    void merge(const BitBattery &next) {
+        if (!next.started && next.pendingLength == 0) {
+            return;
+        }
+        if (started && next.started) {
+            transitions += lastBit != next.firstBit;
+        }
+        if (!started) {
+            firstBit = next.firstBit;
+            started = next.started;
+        }
+        if (next.started) {
+            lastBit = next.lastBit;
+        }
+        bits += next.bits;
+        ones += next.ones;
+        transitions += next.transitions;
+        walkMin = std::min(walkMin, walk + next.walkMin);
+        walkMax = std::max(walkMax, walk + next.walkMax);
+        walk += next.walk;
+        frequencyBlocks += next.frequencyBlocks;
+        frequencySquares += next.frequencySquares;
+        blockWords = next.blockWords;
+        blockOnes = next.blockOnes;
+        for (int c = 0; c < LONGEST_RUN_CLASSES; ++c) {
+            runClasses[c] += next.runClasses[c];
+        }
+        runWords = next.runWords;
+        currentRun = next.currentRun;
+        blockLongest = next.blockLongest;
+        pending = next.pending;
+        pendingLength = next.pendingLength;
+    }
+
+    BitBatteryResult result() const {
+        BitBattery all = *this;
+        for (int k = 0; k < all.pendingLength; ++k) {
+            all.add_tail_byte(all.pending[k]);
+        }
+        const double nan = std::nan("");
+        double n = double(all.bits);
+        BitBatteryResult result{all.bits, nan, nan, nan, nan, nan, nan, nan, nan};
+        if (all.bits == 0) {
+            return result;
+        }
+
+        double sum = 2.0 * double(all.ones) - n;
+        result.frequency = std::erfc(std::fabs(sum) / std::sqrt(2.0 * n));
+
+        if (all.frequencyBlocks > 0) {
+            result.blockFrequencyChisquare = double(all.frequencySquares) / all.blockBits;
+            result.blockFrequency = chisquare_p(result.blockFrequencyChisquare, double(all.frequencyBlocks));
+        }
+
+        double pi = all.ones / n;
+        if (std::fabs(pi - 0.5) >= 2.0 / std::sqrt(n)) {
+            result.runs = 0.0;  // The frequency prerequisite fails
         } else {
-            std::vector<int> byteOccurrences(256, 0);
-    
-            // Iterate over each byte
-            for (auto &byte : data) {
-                byteOccurrences[byte]++;
+            double runs = all.transitions + 1.0;
+            result.runs = std::erfc(std::fabs(runs - 2.0 * n * pi * (1.0 - pi)) / (2.0 * std::sqrt(2.0 * n) * pi * (1.0 - pi)));
+        }
+
+        static const double classProbability[LONGEST_RUN_CLASSES] = {0.1174, 0.2430, 0.2493, 0.1752, 0.1027, 0.1124};
+        double blocks = std::accumulate(all.runClasses.begin(), all.runClasses.end(), 0.0);
+        if (blocks > 0) {
+            double chisquare = 0.0;
+            for (int c = 0; c < LONGEST_RUN_CLASSES; ++c) {
+                double expected = blocks * classProbability[c];
+                chisquare += (all.runClasses[c] - expected) * (all.runClasses[c] - expected) / expected;
             }
-    
-            // Print byte occurrences and fraction
-            for (int byteValue = 0; byteValue < 256; ++byteValue) {
-                double fraction = byteOccurrences[byteValue] / static_cast<double>(data.size());
-                std::cout << "Value: " << byteValue << " Char: " << char(isprint(byteValue) ?  byteValue : ' ') << " Occurrences: " << byteOccurrences[byteValue] << " Fraction: " << fraction << "\n";
+            result.longestRunChisquare = chisquare;
+            result.longestRun = chisquare_p(chisquare, LONGEST_RUN_CLASSES - 1);
+        }
+
+        double forward = std::max(std::fabs(double(all.walkMin)), std::fabs(double(all.walkMax)));
+        double reverse = std::max(std::fabs(double(all.walk - all.walkMin)), std::fabs(double(all.walk - all.walkMax)));
+        result.cumulativeSumsForward = cumulative_sums_p(forward, n);
+        result.cumulativeSumsReverse = cumulative_sums_p(reverse, n);
+        return result;
+    }
+
+    void serialize(std::ostream &out) const {
+        for (uint64_t value : {uint64_t(blockBits), bits, ones, transitions, uint64_t(started), uint64_t(firstBit), uint64_t(lastBit), uint64_t(walk), uint64_t(walkMin), uint64_t(walkMax), frequencyBlocks, frequencySquares, uint64_t(blockWords), blockOnes, uint64_t(runWords), uint64_t(currentRun), uint64_t(blockLongest), uint64_t(pendingLength)}) {
+            write_u64(out, value);
+        }
+        for (auto count : runClasses) {
+            write_u64(out, count);
+        }
+        out.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+    }
+
+    bool deserialize(std::istream &in) {
+        blockBits = uint32_t(read_u64(in));
+        bits = read_u64(in);
+        ones = read_u64(in);
+        transitions = read_u64(in);
+        started = read_u64(in) != 0;
+        firstBit = uint8_t(read_u64(in));
+        lastBit = uint8_t(read_u64(in));
+        walk = int64_t(read_u64(in));
+        walkMin = int64_t(read_u64(in));
+        walkMax = int64_t(read_u64(in));
+        frequencyBlocks = read_u64(in);
+        frequencySquares = read_u64(in);
+        blockWords = uint32_t(read_u64(in));
+        blockOnes = read_u64(in);
+        runWords = uint32_t(read_u64(in));
+        currentRun = uint32_t(read_u64(in));
+        blockLongest = uint32_t(read_u64(in));
+        pendingLength = uint8_t(read_u64(in));
+        for (auto &count : runClasses) {
+            count = read_u64(in);
+        }
+        in.read(reinterpret_cast<char *>(pending.data()), pending.size());
+        return in && blockBits >= 64 && blockBits % 64 == 0 && pendingLength < 8;
+    }
+};
+
+// Binary matrix rank test results for 32 x 32 and 64 x 64 matrices. The chi-square
+// compares the counts of full rank, rank one less and lower rank matrices with their
+// probabilities for random bits; p-values are NaN without matrices.
+struct MatrixRankResult {
+    uint64_t matrices32;
+    double chisquare32;
+    double p32;
+    uint64_t matrices64;
+    double chisquare64;
+    double p64;
+};
+
+// SP 800-22 binary matrix rank test. The bit stream fills the rows of 32 x 32 and 64 x 64
+// matrices over GF(2), most significant bit first, each row one machine word, and the
+// rank comes from Gaussian elimination by XOR of whole rows.
+class MatrixRank {
+private:
+    std::array<uint64_t, 3> ranks32;  // Full rank, full rank - 1, lower
+    std::array<uint64_t, 3> ranks64;
+    std::array<unsigned char, RANK_GROUP_SIZE> pending;
+    uint32_t pendingLength;
+
+    template <typename Word, size_t Size>
+    static int rank(std::array<Word, Size> &rows) {
+        int rank = 0;
+        for (int bit = int(Size) - 1; bit >= 0 && rank < int(Size); --bit) {
+            Word mask = Word(1) << bit;
+            size_t pivot = rank;
+            while (pivot < Size && !(rows[pivot] & mask)) {
+                pivot++;
+            }
+            if (pivot == Size) {
+                continue;
+            }
+            std::swap(rows[rank], rows[pivot]);
+            for (size_t row = rank + 1; row < Size; ++row) {
+                rows[row] ^= rows[rank] & (Word(0) - ((rows[row] >> bit) & 1));
+            }
+            rank++;
+        }
+        return rank;
+    }
+
+    template <typename Word, size_t Size, typename Map = SameByte>
+    static void count_matrix(const unsigned char *bytes, std::array<uint64_t, 3> &ranks, Map map = {}) {
+        std::array<Word, Size> rows;
+        for (size_t row = 0; row < Size; ++row) {
+            Word word = 0;
+            for (size_t k = 0; k < sizeof(Word); ++k) {
+                word = Word(word << 8) | map(bytes[row * sizeof(Word) + k]);
+            }
+            rows[row] = word;
+        }
+        int deficiency = int(Size) - rank(rows);
+        ranks[std::min(deficiency, 2)]++;
+    }
+
+    template <typename Map = SameByte>
+    void add_group(const unsigned char *bytes, Map map = {}) {
+        for (int k = 0; k < RANK_GROUP_SIZE; k += 32 * 4) {
+            count_matrix<uint32_t, 32>(bytes + k, ranks32, map);
+        }
+        count_matrix<uint64_t, 64>(bytes, ranks64, map);
+    }
+
+    // Probability that a random size x size matrix over GF(2) has rank r
+    static double rank_probability(int size, int r) {
+        double logP = (double(r) * (2 * size - r) - double(size) * size) * M_LN2;
+        for (int i = 0; i < r; ++i) {
+            double factor = (1.0 - std::ldexp(1.0, i - size));
+            logP += 2.0 * std::log(factor) - std::log(1.0 - std::ldexp(1.0, i - r));
+        }
+        return std::exp(logP);
+    }
+
+    static void chisquare(int size, const std::array<uint64_t, 3> &ranks, uint64_t &matrices, double &chisquare, double &p) {
+        matrices = ranks[0] + ranks[1] + ranks[2];
+        chisquare = p = std::nan("");
+        if (matrices == 0) {
+            return;
+        }
+        double full = rank_probability(size, size);
+        double less = rank_probability(size, size - 1);
+        double probability[3] = {full, less, 1.0 - full - less};
+        chisquare = 0.0;
+        for (int c = 0; c < 3; ++c) {
+            double expected = probability[c] * matrices;
+            chisquare += (ranks[c] - expected) * (ranks[c] - expected) / expected;
+        }
+        p = std::exp(-chisquare / 2.0);  // Two degrees of freedom
+    }
+
+public:
+    MatrixRank() : ranks32{}, ranks64{}, pending{}, pendingLength(0) {
+    }
+
+    static constexpr size_t alignment() {
+        return RANK_GROUP_SIZE;
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        size_t i = 0;
+        if (pendingLength > 0) {
+            size_t take = std::min<size_t>(size, RANK_GROUP_SIZE - pendingLength);
+            std::transform(bytes, bytes + take, pending.begin() + pendingLength, map);
+            pendingLength += take;
+            i = take;
+            if (pendingLength == RANK_GROUP_SIZE) {
+                add_group(pending.data());
+                pendingLength = 0;
+            }
+        }
+        for (; i + RANK_GROUP_SIZE <= size; i += RANK_GROUP_SIZE) {
+            add_group(bytes + i, map);
+        }
+        std::transform(bytes + i, bytes + size, pending.begin() + pendingLength, map);
+        pendingLength += size - i;
+    }
+
+    // Appends the accumulation of the bytes directly following, both joined at alignment()
+    void merge(const MatrixRank &next) {
+        for (int c = 0; c < 3; ++c) {
+            ranks32[c] += next.ranks32[c];
+            ranks64[c] += next.ranks64[c];
+        }
+        pending = next.pending;
+        pendingLength = next.pendingLength;
+    }
+
+    MatrixRankResult result() const {
+        // Whole 32 x 32 matrices left over at the end still count
+        std::array<uint64_t, 3> tail32 = ranks32;
+        for (uint32_t k = 0; k + 32 * 4 <= pendingLength; k += 32 * 4) {
+            count_matrix<uint32_t, 32>(pending.data() + k, tail32);
+        }
+        MatrixRankResult result;
+        chisquare(32, tail32, result.matrices32, result.chisquare32, result.p32);
+        chisquare(64, ranks64, result.matrices64, result.chisquare64, result.p64);
+        return result;
+    }
+
+    void serialize(std::ostream &out) const {
+        for (uint64_t value : {ranks32[0], ranks32[1], ranks32[2], ranks64[0], ranks64[1], ranks64[2], uint64_t(pendingLength)}) {
+            write_u64(out, value);
+        }
+        out.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+    }
+
+    bool deserialize(std::istream &in) {
+        for (auto &count : ranks32) {
+            count = read_u64(in);
+        }
+        for (auto &count : ranks64) {
+            count = read_u64(in);
+        }
+        pendingLength = uint32_t(read_u64(in));
+        in.read(reinterpret_cast<char *>(pending.data()), pending.size());
+        return in && pendingLength < RANK_GROUP_SIZE;
+    }
+};
+
+// Linear complexity test results. The chi-square compares the deviations of the block
+// complexities from their mean for random bits in seven classes; minimum is the shortest
+// LFSR found for any block.
+struct LinearComplexityResult {
+    uint64_t blocks;
+    uint32_t blockBits;
+    uint32_t minimum;
+    double chisquare;
+    double p_value;
+};
+
+// SP 800-22 linear complexity test. Each block of blockBits bits, most significant bit
+// first, goes through Berlekamp-Massey on 64-bit words: the connection polynomials are
+// bit sets and each discrepancy is the parity of the polynomial ANDed with a window of
+// the bit-reversed block.
+class LinearComplexity {
+private:
+    uint32_t blockBits;
+    std::array<uint64_t, LINEAR_COMPLEXITY_CLASSES> classes;
+    uint32_t minimum;
+    std::vector<unsigned char> pending;
+    // Berlekamp-Massey work space, sized for blockBits once and reused by every block
+    std::vector<uint64_t> reversed;
+    std::vector<uint64_t> connection;
+    std::vector<uint64_t> previous;
+    std::vector<uint64_t> saved;
+
+    void size_work_space() {
+        size_t words = blockBits / 64 + 2;
+        reversed.assign(words + 1, 0);
+        connection.assign(words, 0);
+        previous.assign(words, 0);
+        saved.assign(words, 0);
+    }
+
+    // 64 bits of the LSB-first bit set from position on
+    static uint64_t bits_at(const uint64_t *words, size_t position) {
+        size_t word = position / 64;
+        int shift = int(position % 64);
+        return shift == 0 ? words[word] : (words[word] >> shift) | (words[word + 1] << (64 - shift));
+    }
+
+    template <typename Map = SameByte>
+    uint32_t complexity(const unsigned char *bytes, Map map = {}) {
+        size_t words = connection.size();
+        // Bit k of reversed is bit blockBits - 1 - k of the block, so the bits preceding
+        // bit n lie from position blockBits - 1 - n upwards
+        std::fill(reversed.begin(), reversed.end(), 0);
+        std::fill(connection.begin(), connection.end(), 0);
+        std::fill(previous.begin(), previous.end(), 0);
+        for (uint32_t k = 0; k < blockBits; ++k) {
+            uint32_t bit = blockBits - 1 - k;
+            reversed[k / 64] |= uint64_t((map(bytes[bit / 8]) >> (7 - bit % 8)) & 1) << (k % 64);
+        }
+        connection[0] = previous[0] = 1;
+        uint32_t length = 0;
+        int64_t changed = -1;
+        for (uint32_t n = 0; n < blockBits; ++n) {
+            size_t start = blockBits - 1 - n;
+            uint64_t parity = 0;
+            for (size_t w = 0; w <= length / 64; ++w) {
+                parity ^= connection[w] & bits_at(reversed.data(), start + 64 * w);
+            }
+            if ((std::popcount(parity) & 1) == 0) {
+                continue;
+            }
+            // connection ^= previous << (n - changed)
+            size_t shift = size_t(n - changed);
+            size_t wordShift = shift / 64;
+            int bitShift = int(shift % 64);
+            bool grow = 2 * length <= n;
+            if (grow) {
+                saved = connection;
+            }
+            // Both polynomials have degree at most n + 1
+            for (size_t w = std::min(words, size_t(n) / 64 + 2); w-- > wordShift;) {
+                uint64_t moved = previous[w - wordShift] << bitShift;
+                if (bitShift != 0 && w > wordShift) {
+                    moved |= previous[w - wordShift - 1] >> (64 - bitShift);
+                }
+                connection[w] ^= moved;
+            }
+            if (grow) {
+                length = n + 1 - length;
+                changed = n;
+                previous.swap(saved);
+            }
+        }
+        return length;
+    }
+
+    template <typename Map = SameByte>
+    void add_block(const unsigned char *bytes, Map map = {}) {
+        uint32_t length = complexity(bytes, map);
+        double m = blockBits;
+        double sign = (blockBits % 2) ? -1.0 : 1.0;
+        double mean = m / 2.0 + (9.0 + (blockBits % 2 ? 1.0 : -1.0)) / 36.0 - (m / 3.0 + 2.0 / 9.0) / std::ldexp(1.0, int(blockBits));
+        double t = sign * (length - mean) + 2.0 / 9.0;
+        int c = t <= -2.5 ? 0 : t <= -1.5 ? 1 : t <= -0.5 ? 2 : t <= 0.5 ? 3 : t <= 1.5 ? 4 : t <= 2.5 ? 5 : 6;
+        classes[c]++;
+        minimum = std::min(minimum, length);
+    }
+
+public:
+    LinearComplexity(uint32_t blockBits = 512) : blockBits(std::clamp<uint32_t>(blockBits / 8 * 8, 64, LINEAR_COMPLEXITY_MAX_BLOCK)), classes{}, minimum(UINT32_MAX) {
+        size_work_space();
+    }
+
+    uint32_t get_block_bits() const {
+        return blockBits;
+    }
+
+    size_t alignment() const {
+        return blockBits / 8;
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        size_t blockBytes = blockBits / 8;
+        size_t i = 0;
+        if (!pending.empty()) {
+            size_t take = std::min(size, blockBytes - pending.size());
+            std::transform(bytes, bytes + take, std::back_inserter(pending), map);
+            i = take;
+            if (pending.size() == blockBytes) {
+                add_block(pending.data());
+                pending.clear();
             }
         }
+        for (; i + blockBytes <= size; i += blockBytes) {
+            add_block(bytes + i, map);
+        }
+        std::transform(bytes + i, bytes + size, std::back_inserter(pending), map);
+    }
+
+    // Appends the accumulation of the bytes directly following, both joined at alignment()
+    void merge(const LinearComplexity &next) {
+        for (int c = 0; c < LINEAR_COMPLEXITY_CLASSES; ++c) {
+            classes[c] += next.classes[c];
+        }
+        minimum = std::min(minimum, next.minimum);
+        pending = next.pending;
+    }
+
+    LinearComplexityResult result() const {
+        static const double classProbability[LINEAR_COMPLEXITY_CLASSES] = {0.010417, 0.03125, 0.125, 0.5, 0.25, 0.0625, 0.020833};
+        uint64_t blocks = std::accumulate(classes.begin(), classes.end(), uint64_t(0));
+        LinearComplexityResult result{blocks, blockBits, blocks ? minimum : 0, std::nan(""), std::nan("")};
+        if (blocks == 0) {
+            return result;
+        }
+        result.chisquare = 0.0;
+        for (int c = 0; c < LINEAR_COMPLEXITY_CLASSES; ++c) {
+            double expected = blocks * classProbability[c];
+            result.chisquare += (classes[c] - expected) * (classes[c] - expected) / expected;
+        }
+        result.p_value = chisquare_p(result.chisquare, LINEAR_COMPLEXITY_CLASSES - 1);
+        return result;
+    }
+
+    void serialize(std::ostream &out) const {
+        write_u64(out, blockBits);
+        for (auto count : classes) {
+            write_u64(out, count);
+        }
+        write_u64(out, minimum);
+        write_u64(out, pending.size());
+        out.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+    }
+
+    bool deserialize(std::istream &in) {
+        blockBits = uint32_t(read_u64(in));
+        for (auto &count : classes) {
+            count = read_u64(in);
+        }
+        minimum = uint32_t(read_u64(in));
+        uint64_t pendingSize = read_u64(in);
+        if (!in || blockBits < 64 || blockBits % 8 != 0 || blockBits > LINEAR_COMPLEXITY_MAX_BLOCK || pendingSize >= blockBits / 8) {
+            return false;
+        }
+        size_work_space();
+        pending.resize(pendingSize);
+        in.read(reinterpret_cast<char *>(pending.data()), pendingSize);
+        return bool(in);
+    }
+};
+
+// Maurer's universal statistical test results. The statistic is the mean log2 distance
+// between repeats of L-bit patterns over the test blocks, close to expected for random bits.
+struct UniversalResult {
+    uint32_t blockBits;
+    uint64_t blocks;  // Test blocks, after the 10 * 2^L initialization blocks
+    double statistic;
+    double expected;
+    double p_value;
+};
+
+// SP 800-22 Maurer's universal statistical test over non-overlapping L-bit blocks, most
+// significant bit first. Block numbers are global to the stream. A segment keeps the first
+// and last block number of every pattern, so the repeats that span two segments are
+// counted when they merge.
+class Universal {
+private:
+    uint32_t blockBits;
+    bool started;
+    uint64_t nextBlock;  // Numbered from 1 as in SP 800-22, 0 marks a pattern not seen
+    std::vector<uint64_t> first;
+    std::vector<uint64_t> last;
+    double logSum;
+    uint32_t buffer;
+    int bufferBits;
+
+    uint64_t initialization_blocks() const {
+        return uint64_t(10) << blockBits;
+    }
+
+    void add_block(uint32_t pattern) {
+        uint64_t block = nextBlock++;
+        if (last[pattern] == 0) {
+            first[pattern] = block;
+        } else if (block > initialization_blocks()) {
+            logSum += std::log2(double(block - last[pattern]));
+        }
+        last[pattern] = block;
+    }
+
+public:
+    Universal(uint32_t blockBits = 8) : blockBits(std::clamp<uint32_t>(blockBits, UNIVERSAL_MIN_BLOCK, UNIVERSAL_MAX_BLOCK)), started(false), nextBlock(1), first(size_t(1) << this->blockBits, 0), last(size_t(1) << this->blockBits, 0), logSum(0.0), buffer(0), bufferBits(0) {
+    }
+
+    // The SP 800-22 recommended L for a stream of the given number of bits
+    static uint32_t block_bits_for(uint64_t bits) {
+        static const uint64_t minimumBits[UNIVERSAL_MAX_BLOCK - UNIVERSAL_MIN_BLOCK] = {904960, 2068480, 4654080, 10342400, 22753280, 49643520, 107560960, 231669760, 496435200, 1059061760};
+        uint32_t blockBits = UNIVERSAL_MIN_BLOCK;
+        while (blockBits < UNIVERSAL_MAX_BLOCK && bits >= minimumBits[blockBits - UNIVERSAL_MIN_BLOCK]) {
+            blockBits++;
+        }
+        return blockBits;
+    }
+
+    uint32_t get_block_bits() const {
+        return blockBits;
+    }
+
+    size_t alignment() const {
+        return blockBits / std::gcd(blockBits, 8u);
+    }
+
+    // position is the offset of bytes in the stream, a multiple of alignment() on the first call
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, uint64_t position, Map map = {}) {
+        if (!started) {
+            nextBlock = position * 8 / blockBits + 1;
+            started = true;
+        }
+        uint32_t mask = (uint32_t(1) << blockBits) - 1;
+        for (size_t i = 0; i < size; ++i) {
+            buffer = (buffer << 8) | map(bytes[i]);
+            bufferBits += 8;
+            while (bufferBits >= int(blockBits)) {
+                bufferBits -= blockBits;
+                add_block((buffer >> bufferBits) & mask);
+            }
+        }
+    }
+
+    // Appends the accumulation of the bytes directly following, both joined at alignment()
+    void merge(const Universal &next) {
+        if (!next.started) {
+            return;
+        }
+        if (!started) {
+            *this = next;
+            return;
+        }
+        for (size_t pattern = 0; pattern < first.size(); ++pattern) {
+            uint64_t block = next.first[pattern];
+            if (block == 0) {
+                continue;
+            }
+            if (last[pattern] == 0) {
+                first[pattern] = block;
+            } else if (block > initialization_blocks()) {
+                logSum += std::log2(double(block - last[pattern]));
+            }
+            last[pattern] = next.last[pattern];
+        }
+        logSum += next.logSum;
+        nextBlock = next.nextBlock;
+        buffer = next.buffer;
+        bufferBits = next.bufferBits;
+    }
+
+    UniversalResult result() const {
+        static const double expectedValue[UNIVERSAL_MAX_BLOCK - UNIVERSAL_MIN_BLOCK + 1] = {5.2177052, 6.1962507, 7.1836656, 8.1764248, 9.1723243, 10.170032, 11.168765, 12.168070, 13.167693, 14.167488, 15.167379};
+        static const double variance[UNIVERSAL_MAX_BLOCK - UNIVERSAL_MIN_BLOCK + 1] = {2.954, 3.125, 3.238, 3.311, 3.356, 3.384, 3.401, 3.410, 3.416, 3.419, 3.421};
+        double expected = expectedValue[blockBits - UNIVERSAL_MIN_BLOCK];
+        uint64_t blocks = nextBlock - 1;
+        UniversalResult result{blockBits, 0, std::nan(""), expected, std::nan("")};
+        if (blocks <= initialization_blocks()) {
+            return result;
+        }
+        // Patterns first seen among the test blocks repeat the all-zero initial table entry
+        double sum = logSum;
+        for (uint64_t block : first) {
+            if (block > initialization_blocks()) {
+                sum += std::log2(double(block));
+            }
+        }
+        double l = blockBits;
+        double k = double(blocks - initialization_blocks());
+        double c = 0.7 - 0.8 / l + (4.0 + 32.0 / l) * std::pow(k, -3.0 / l) / 15.0;
+        double sigma = c * std::sqrt(variance[blockBits - UNIVERSAL_MIN_BLOCK] / k);
+        result.blocks = uint64_t(k);
+        result.statistic = sum / k;
+        result.p_value = std::erfc(std::fabs(result.statistic - expected) / (M_SQRT2 * sigma));
+        return result;
+    }
+
+    void serialize(std::ostream &out) const {
+        for (uint64_t value : {uint64_t(blockBits), uint64_t(started), nextBlock, std::bit_cast<uint64_t>(logSum), uint64_t(buffer), uint64_t(bufferBits)}) {
+            write_u64(out, value);
+        }
+        for (size_t pattern = 0; pattern < first.size(); ++pattern) {
+            write_u64(out, first[pattern]);
+            write_u64(out, last[pattern]);
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t bits = read_u64(in);
+        if (!in || bits < UNIVERSAL_MIN_BLOCK || bits > UNIVERSAL_MAX_BLOCK) {
+            return false;
+        }
+        *this = Universal(uint32_t(bits));
+        started = read_u64(in) != 0;
+        nextBlock = read_u64(in);
+        logSum = std::bit_cast<double>(read_u64(in));
+        buffer = uint32_t(read_u64(in));
+        bufferBits = int(read_u64(in));
+        for (size_t pattern = 0; pattern < first.size(); ++pattern) {
+            first[pattern] = read_u64(in);
+            last[pattern] = read_u64(in);
+        }
+        return in && bufferBits >= 0 && bufferBits < int(blockBits);
+    }
+};
+
+// Birthday spacings test results. Each trial draws birthdays of sampleBits bits from
+// consecutive input bytes; the number of repeated spacings between the sorted birthdays
+// is Poisson with mean lambda per trial for random input.
+struct BirthdayResult {
+    uint32_t sampleBits;
+    uint64_t trials;
+    uint64_t birthdays;  // Per trial
+    double lambda;
+    uint64_t collisions;  // Over all trials
+    double p_value;       // Two-sided, of the collision total
+};
+
+// Bias of one bit position of bytes, or bit plane of wider symbols, 0 the least significant:
+// the fraction of ones with its chi-square and p-value, and the correlation of the bit with
+// the same bit of the next sample.
+struct BitPositionResult {
+    uint32_t position;
+    double ones;
+    double chisquare;
+    double p_value;
+    double correlation;
+};
+
+// Statistics of the bytes at one offset within fixed-size records
+struct ColumnResult {
+    uint32_t column;
+    uint64_t samples;
+    double entropy;
+    double chisquare;
+    double p_value;
+    double mean;
+};
+
+// Entropy of the fields of IEEE 754 values, in bits per field, and of the bytes of each value
+// XOR the one before it. Mantissa and XOR bytes are listed most significant first; the first
+// mantissa byte holds the bits left over above whole bytes.
+struct FloatFieldResult {
+    uint32_t bits;  // 32 or 64
+    uint64_t values;
+    double signEntropy;
+    double exponentEntropy;
+    std::vector<double> mantissaEntropy;
+    double xorEntropy;  // All bytes of the XOR deltas, bits per byte
+    std::vector<double> xorByteEntropy;
+};
+
+// Byte statistics of the data after a transform: "delta" is each byte minus the one before
+// it modulo 256, "xor" each byte XOR the byte lag positions back. The first lag bytes have
+// no predecessor and are left out.
+struct TransformResult {
+    std::string name;
+    uint32_t lag;
+    uint64_t samples;
+    double entropy;
+    double chisquare;
+    double p_value;
+    double mean;
+};
+
+// Knuth's poker, gap and coupon collector tests on symbols of symbolBits bits. Poker counts
+// the distinct symbols in hands of five, gap the distances between symbols in the lower half
+// of the alphabet, coupon collector the symbols until every value has appeared.
+struct KnuthResult {
+    uint32_t symbolBits;
+    uint64_t hands;
+    double pokerChisquare;
+    double pokerP;
+    uint64_t gaps;
+    double gapChisquare;
+    double gapP;
+    uint64_t coupons;
+    double couponChisquare;
+    double couponP;
+};
+
+// Serial and approximate entropy test results for one pattern length m
+struct PatternResult {
+    uint32_t length;
+    double serialDelta;        // Change of psi-square from m - 1 to m bits
+    double serialP;
+    double serialDelta2;       // Second difference of psi-square over m - 2, m - 1 and m bits
+    double serialP2;
+    double approximateEntropy;
+    double approximateEntropyP;
+};
+
+// SP 800-22 serial and approximate entropy tests. A rolling register counts the overlapping
+// (M + 1)-bit patterns of the stream, most significant bit first, wrapping around at the end.
+// With the wrap around, the counts of every shorter pattern are sums of these, so the tests
+// for all m up to M come out of one pass and one counter array.
+class Patterns {
+private:
+    uint32_t maxLength;
+    std::vector<uint64_t> counts;
+    uint64_t bits;
+    uint32_t head;  // The first and last (up to) M bits, for patterns across joins
+    uint32_t headBits;
+    uint32_t tail;
+
+    uint32_t width() const {
+        return maxLength + 1;
+    }
+
+    uint32_t edge_bits(uint64_t count) const {
+        return uint32_t(std::min<uint64_t>(count, maxLength));
+    }
+
+    // Counts the patterns of sequence (length bits) that start before split and end after it
+    void count_across(uint64_t sequence, uint32_t length, uint32_t split) {
+        uint64_t mask = (uint64_t(1) << width()) - 1;
+        for (uint32_t start = 0; start < split && start + width() <= length; ++start) {
+            counts[(sequence >> (length - start - width())) & mask]++;
+        }
+    }
+
+    static double psi_square(const std::vector<uint64_t> &patterns, double n) {
+        double sum = 0.0;
+        for (uint64_t count : patterns) {
+            sum += double(count) * double(count);
+        }
+        return double(patterns.size()) / n * sum - n;
+    }
+
+    static double phi(const std::vector<uint64_t> &patterns, double n) {
+        double sum = 0.0;
+        for (uint64_t count : patterns) {
+            if (count > 0) {
+                sum += double(count) / n * std::log(double(count) / n);
+            }
+        }
+        return sum;
+    }
+
+public:
+    Patterns(uint32_t maxLength = 10) : maxLength(std::clamp<uint32_t>(maxLength, 2, PATTERN_MAX_LENGTH)), counts(size_t(1) << width(), 0), bits(0), head(0), headBits(0), tail(0) {
+    }
+
+    uint32_t get_max_length() const {
+        return maxLength;
+    }
+
+    static constexpr size_t alignment() {
+        return 1;
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        uint64_t mask = (uint64_t(1) << width()) - 1;
+        uint64_t window = tail;
+        size_t i = 0;
+        // Until the first whole pattern only the patterns already complete are counted
+        for (; i < size && bits < width(); ++i) {
+            window = (window << 8) | map(bytes[i]);
+            for (int bit = 7; bit >= 0; --bit) {
+                if (headBits < maxLength) {
+                    head = (head << 1) | ((window >> bit) & 1);
+                    headBits++;
+                }
+                if (++bits >= width()) {
+                    counts[(window >> bit) & mask]++;
+                }
+            }
+        }
+        bits += 8 * (size - i);
+        for (; i < size; ++i) {
+            window = (window << 8) | map(bytes[i]);
+            for (int bit = 7; bit >= 0; --bit) {
+                counts[(window >> bit) & mask]++;
+            }
+        }
+        tail = uint32_t(window & ((uint64_t(1) << maxLength) - 1));
+    }
+
+    // Appends the accumulation of the bits directly following
+    void merge(const Patterns &next) {
+        if (next.bits == 0) {
+            return;
+        }
+        if (bits == 0) {
+            *this = next;
+            return;
+        }
+        for (size_t pattern = 0; pattern < counts.size(); ++pattern) {
+            counts[pattern] += next.counts[pattern];
+        }
+        uint32_t tailBits = edge_bits(bits);
+        count_across((uint64_t(tail) << next.headBits) | next.head, tailBits + next.headBits, tailBits);
+        if (headBits < maxLength) {
+            uint32_t take = std::min(maxLength - headBits, next.headBits);
+            head = (head << take) | (next.head >> (next.headBits - take));
+            headBits += take;
+        }
+        uint32_t nextTailBits = edge_bits(next.bits);
+        tail = uint32_t(((uint64_t(tail) << nextTailBits) | next.tail) & ((uint64_t(1) << maxLength) - 1));
+        bits += next.bits;
+    }
+
+    // Results for m = 2 to M; NaN when the stream is shorter than M + 1 bits
+    std::vector<PatternResult> result() const {
+        const double nan = std::nan("");
+        std::vector<PatternResult> results;
+        for (uint32_t m = 2; m <= maxLength; ++m) {
+            results.push_back({m, nan, nan, nan, nan, nan, nan});
+        }
+        if (bits < width()) {
+            return results;
+        }
+        // Patterns wrapping around from the end of the stream to its start
+        Patterns all = *this;
+        uint32_t tailBits = edge_bits(bits);
+        all.count_across((uint64_t(tail) << headBits) | head, tailBits + headBits, tailBits);
+
+        // psi-square and phi of every width from 0 to M + 1, narrowing by summing pairs
+        double n = double(bits);
+        std::vector<double> psi(width() + 1, 0.0), phis(width() + 1, 0.0);
+        std::vector<uint64_t> patterns = all.counts;
+        for (uint32_t w = width(); w >= 1; --w) {
+            psi[w] = psi_square(patterns, n);
+            phis[w] = phi(patterns, n);
+            std::vector<uint64_t> narrower(patterns.size() / 2);
+            for (size_t p = 0; p < narrower.size(); ++p) {
+                narrower[p] = patterns[2 * p] + patterns[2 * p + 1];
+            }
+            patterns.swap(narrower);
+        }
+        for (PatternResult &r : results) {
+            uint32_t m = r.length;
+            r.serialDelta = psi[m] - psi[m - 1];
+            r.serialDelta2 = psi[m] - 2.0 * psi[m - 1] + psi[m - 2];
+            r.serialP = igamc(std::ldexp(1.0, int(m) - 2), r.serialDelta / 2.0);
+            r.serialP2 = igamc(std::ldexp(1.0, int(m) - 3), r.serialDelta2 / 2.0);
+            r.approximateEntropy = phis[m] - phis[m + 1];
+            r.approximateEntropyP = igamc(std::ldexp(1.0, int(m) - 1), n * (M_LN2 - r.approximateEntropy));
+        }
+        return results;
+    }
+
+    void serialize(std::ostream &out) const {
+        for (uint64_t value : {uint64_t(maxLength), bits, uint64_t(head), uint64_t(headBits), uint64_t(tail)}) {
+            write_u64(out, value);
+        }
+        for (uint64_t count : counts) {
+            write_u64(out, count);
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t length = read_u64(in);
+        if (!in || length < 2 || length > PATTERN_MAX_LENGTH) {
+            return false;
+        }
+        *this = Patterns(uint32_t(length));
+        bits = read_u64(in);
+        head = uint32_t(read_u64(in));
+        headBits = uint32_t(read_u64(in));
+        tail = uint32_t(read_u64(in));
+        for (uint64_t &count : counts) {
+            count = read_u64(in);
+        }
+        return in && headBits == edge_bits(bits);
+    }
+};
+
+// Ones and changes from one byte to the next, for each of the eight bit positions. Blocks of
+// 64 bytes are reduced by a carry-save adder tree to a plane of the positions that were set
+// eight times, and those planes go into vertical byte-lane counters, so bits are only
+// counted per position once per 255 blocks.
+class BitPositions {
+private:
+    static constexpr uint64_t LANES = 0x0101010101010101ull;  // Bit 0 of every byte
+    static constexpr int BLOCK = 64;
+
+    uint64_t length;
+    unsigned char first;
+    unsigned char last;
+    std::array<uint64_t, 8> ones;
+    std::array<uint64_t, 8> changes;
+
+    static void csa(uint64_t &high, uint64_t &low, uint64_t a, uint64_t b, uint64_t c) {
+        uint64_t u = a ^ b;
+        high = (a & b) | (u & c);
+        low = u ^ c;
+    }
+
+    template <typename Map>
+    static uint64_t load(const unsigned char *bytes, Map map) {
+        uint64_t word = 0;
+        if constexpr (std::is_same_v<Map, SameByte>) {
+            std::memcpy(&word, bytes, sizeof(word));
+        } else {
+            // Lanes are only summed, so their order within the word does not matter
+            for (int k = 0; k < 8; ++k) {
+                word |= uint64_t(map(bytes[k])) << (8 * k);
+            }
+        }
+        return word;
+    }
+
+    // Adds the set bits of a word or byte to counts, by position within its bytes
+    static void add_bits(std::array<uint64_t, 8> &counts, uint64_t word, uint64_t weight) {
+        for (int b = 0; b < 8; ++b) {
+            counts[b] += weight * std::popcount((word >> b) & LANES);
+        }
+    }
+
+    // Sum of the eight byte lanes
+    static uint64_t lane_sum(uint64_t lanes) {
+        uint64_t pairs = (lanes & 0x00FF00FF00FF00FFull) + ((lanes >> 8) & 0x00FF00FF00FF00FFull);
+        return (pairs * 0x0001000100010001ull) >> 48;
+    }
+
+    // Counts the words of blocks into counts, the words being made by word(i, k)
+    template <typename Word>
+    static void count_blocks(std::array<uint64_t, 8> &counts, size_t blocks, Word word) {
+        uint64_t onesPlane = 0, twos = 0, fours = 0;
+        std::array<uint64_t, 8> lanes{};
+        for (size_t i = 0; i < blocks; ++i) {
+            uint64_t twosA, twosB, foursA, foursB, eights;
+            csa(twosA, onesPlane, onesPlane, word(i, 0), word(i, 1));
+            csa(twosB, onesPlane, onesPlane, word(i, 2), word(i, 3));
+            csa(foursA, twos, twos, twosA, twosB);
+            csa(twosA, onesPlane, onesPlane, word(i, 4), word(i, 5));
+            csa(twosB, onesPlane, onesPlane, word(i, 6), word(i, 7));
+            csa(foursB, twos, twos, twosA, twosB);
+            csa(eights, fours, fours, foursA, foursB);
+            for (int b = 0; b < 8; ++b) {
+                lanes[b] += (eights >> b) & LANES;
+            }
+            // A lane holds at most 255
+            if (i % 255 == 254 || i + 1 == blocks) {
+                for (int b = 0; b < 8; ++b) {
+                    counts[b] += 8 * lane_sum(lanes[b]);
+                }
+                lanes = {};
+            }
+        }
+        add_bits(counts, onesPlane, 1);
+        add_bits(counts, twos, 2);
+        add_bits(counts, fours, 4);
+    }
+
+public:
+    BitPositions() : length(0), first(0), last(0), ones{}, changes{} {
+    }
+
+    static constexpr size_t alignment() {
+        return 1;
+    }
+
+    // Result of one position from the counts over samples, with the bit of the first and last
+    static BitPositionResult position_result(uint32_t position, uint64_t samples, uint64_t ones, uint64_t changes, int firstBit, int lastBit) {
+        const double nan = std::nan("");
+        BitPositionResult result{position, nan, nan, nan, nan};
+        if (samples == 0) {
+            return result;
+        }
+        double n = double(samples);
+        result.ones = double(ones) / n;
+        result.chisquare = (2.0 * double(ones) - n) * (2.0 * double(ones) - n) / n;
+        result.p_value = chisquare_p(result.chisquare, 1.0);
+        // Over bits the sum of products is the number of adjacent 11 pairs
+        double sumX = double(ones) - lastBit;
+        double sumY = double(ones) - firstBit;
+        double sumXY = (sumX + sumY - double(changes)) / 2.0;
+        double pairs = n - 1.0;
+        result.correlation = (pairs * sumXY - sumX * sumY) / std::sqrt((pairs * sumX - sumX * sumX) * (pairs * sumY - sumY * sumY));
+        return result;
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        if (size == 0) {
+            return;
+        }
+        if (length == 0) {
+            first = map(bytes[0]);
+        } else {
+            add_bits(changes, uint64_t(last ^ map(bytes[0])), 1);
+        }
+        // Changes need the byte after the block as well
+        size_t blocks = (size - 1) / BLOCK;
+        count_blocks(ones, blocks, [&](size_t i, int k) { return load(bytes + i * BLOCK + 8 * k, map); });
+        count_blocks(changes, blocks, [&](size_t i, int k) {
+            const unsigned char *at = bytes + i * BLOCK + 8 * k;
+            return load(at, map) ^ load(at + 1, map);
+        });
+        for (size_t i = blocks * BLOCK; i < size; ++i) {
+            add_bits(ones, map(bytes[i]), 1);
+            if (i + 1 < size) {
+                add_bits(changes, uint64_t(map(bytes[i]) ^ map(bytes[i + 1])), 1);
+            }
+        }
+        last = map(bytes[size - 1]);
+        length += size;
+    }
+
+    void merge(const BitPositions &next) {
+        if (next.length == 0) {
+            return;
+        }
+        if (length == 0) {
+            *this = next;
+            return;
+        }
+        add_bits(changes, uint64_t(last ^ next.first), 1);
+        for (int b = 0; b < 8; ++b) {
+            ones[b] += next.ones[b];
+            changes[b] += next.changes[b];
+        }
+        last = next.last;
+        length += next.length;
+    }
+
+    std::vector<BitPositionResult> result() const {
+        std::vector<BitPositionResult> results;
+        for (uint32_t b = 0; b < 8; ++b) {
+            results.push_back(position_result(b, length, ones[b], changes[b], (first >> b) & 1, (last >> b) & 1));
+        }
+        return results;
+    }
+
+    void serialize(std::ostream &out) const {
+        write_u64(out, length);
+        write_u64(out, uint64_t(first) | uint64_t(last) << 8);
+        for (int b = 0; b < 8; ++b) {
+            write_u64(out, ones[b]);
+            write_u64(out, changes[b]);
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        length = read_u64(in);
+        uint64_t ends = read_u64(in);
+        first = (unsigned char)(ends & 0xFF);
+        last = (unsigned char)(ends >> 8);
+        for (int b = 0; b < 8; ++b) {
+            ones[b] = read_u64(in);
+            changes[b] = read_u64(in);
+        }
+        return bool(in);
+    }
+};
+
+// A byte histogram for every offset modulo the record size, the offset taken from the
+// position in the whole stream. The counters are laid out column by column, so a whole
+// record updates recordSize different tables with no branch on the column.
+class Columns {
+private:
+    uint32_t recordSize;
+    std::vector<uint64_t> counts;  // recordSize tables of BYTE_VAL_COUNT
+
+public:
+    Columns(uint32_t recordSize = 16) : recordSize(std::clamp<uint32_t>(recordSize, 1, COLUMN_MAX_RECORD)), counts(size_t(this->recordSize) * BYTE_VAL_COUNT, 0) {
+    }
+
+    uint32_t get_record_size() const {
+        return recordSize;
+    }
+
+    static constexpr size_t alignment() {
+        return 1;
+    }
+
+    // position is the offset of bytes in the stream
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, uint64_t position, Map map = {}) {
+        size_t i = 0;
+        uint32_t column = uint32_t(position % recordSize);
+        // Up to the start of the next record
+        for (; i < size && column != 0; ++i) {
+            counts[size_t(column) * BYTE_VAL_COUNT + map(bytes[i])]++;
+            column = column + 1 == recordSize ? 0 : column + 1;
+        }
+        uint64_t *table = counts.data();
+        for (; i + recordSize <= size; i += recordSize) {
+            const unsigned char *record = bytes + i;
+            for (uint32_t c = 0; c < recordSize; ++c) {
+                table[size_t(c) * BYTE_VAL_COUNT + map(record[c])]++;
+            }
+        }
+        for (uint32_t c = 0; i < size; ++i, ++c) {
+            table[size_t(c) * BYTE_VAL_COUNT + map(bytes[i])]++;
+        }
+    }
+
+    // Columns are fixed by stream position, so counts of any two stretches simply add
+    void merge(const Columns &next) {
+        for (size_t k = 0; k < counts.size(); ++k) {
+            counts[k] += next.counts[k];
+        }
+    }
+
+    std::vector<ColumnResult> result() const {
+        std::vector<ColumnResult> results;
+        for (uint32_t c = 0; c < recordSize; ++c) {
+            const uint64_t *histogram = counts.data() + size_t(c) * BYTE_VAL_COUNT;
+            uint64_t total = std::accumulate(histogram, histogram + BYTE_VAL_COUNT, uint64_t(0));
+            ColumnResult result{c, total, std::nan(""), std::nan(""), std::nan(""), std::nan("")};
+            if (total > 0) {
+                double n = double(total);
+                double expected = n / BYTE_VAL_COUNT;
+                double entropy = 0.0, chisquare = 0.0, sum = 0.0;
+                for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+                    double count = double(histogram[value]);
+                    if (count > 0) {
+                        entropy -= count / n * std::log2(count / n);
+                    }
+                    chisquare += (count - expected) * (count - expected) / expected;
+                    sum += double(value) * count;
+                }
+                result.entropy = entropy;
+                result.chisquare = chisquare;
+                result.p_value = chisquare_p(chisquare, BYTE_VAL_COUNT - 1);
+                result.mean = sum / n;
+            }
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    void serialize(std::ostream &out) const {
+        write_u64(out, recordSize);
+        for (uint64_t count : counts) {
+            write_u64(out, count);
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t size = read_u64(in);
+        if (!in || size == 0 || size > COLUMN_MAX_RECORD) {
+            return false;
+        }
+        *this = Columns(uint32_t(size));
+        for (uint64_t &count : counts) {
+            count = read_u64(in);
+        }
+        return bool(in);
+    }
+};
+
+// Field histograms of float32 or float64 values stored with the given byte order. Each value
+// is split into sign, exponent and mantissa bytes with shifts and masks only, and XORed with
+// the previous value, whose bytes go into per-byte histograms.
+class FloatFields {
+private:
+    uint32_t bits;
+    Endian order;
+    uint64_t values;
+    uint64_t firstValue;
+    uint64_t lastValue;
+    std::array<uint64_t, 2> sign;
+    std::vector<uint64_t> exponent;
+    std::vector<uint64_t> mantissa;  // mantissa_bytes() tables of BYTE_VAL_COUNT
+    std::vector<uint64_t> delta;  // bits / 8 tables of BYTE_VAL_COUNT
+    std::array<unsigned char, 8> pending;
+    uint32_t pendingLength;
+
+    uint32_t exponent_bits() const {
+        return bits == 64 ? 11 : 8;
+    }
+    uint32_t mantissa_bits() const {
+        return bits - 1 - exponent_bits();
+    }
+    uint32_t mantissa_bytes() const {
+        return (mantissa_bits() + 7) / 8;
+    }
+
+    template <typename Map = SameByte>
+    uint64_t value_at(const unsigned char *bytes, Map map = {}) const {
+        uint64_t value = 0;
+        uint32_t size = bits / 8;
+        for (uint32_t k = 0; k < size; ++k) {
+            value = (value << 8) | map(bytes[order == Endian::Big ? k : size - 1 - k]);
+        }
+        return value;
+    }
+
+    void add_delta(uint64_t change) {
+        uint32_t size = bits / 8;
+        for (uint32_t k = 0; k < size; ++k) {
+            delta[size_t(k) * BYTE_VAL_COUNT + ((change >> (8 * (size - 1 - k))) & 0xFF)]++;
+        }
+    }
+
+    void add_value(uint64_t value) {
+        uint32_t mantissaBits = mantissa_bits();
+        uint32_t mantissaBytes = mantissa_bytes();
+        sign[value >> (bits - 1)]++;
+        exponent[(value >> mantissaBits) & ((uint64_t(1) << exponent_bits()) - 1)]++;
+        uint64_t fraction = value & ((uint64_t(1) << mantissaBits) - 1);
+        for (uint32_t k = 0; k < mantissaBytes; ++k) {
+            mantissa[size_t(k) * BYTE_VAL_COUNT + ((fraction >> (8 * (mantissaBytes - 1 - k))) & 0xFF)]++;
+        }
+        if (values == 0) {
+            firstValue = value;
+        } else {
+            add_delta(value ^ lastValue);
+        }
+        lastValue = value;
+        values++;
+    }
+
+    static double entropy_of(const uint64_t *counts, size_t bins) {
+        uint64_t total = std::accumulate(counts, counts + bins, uint64_t(0));
+        if (total == 0) {
+            return std::nan("");
+        }
+        double n = double(total);
+        double entropy = 0.0;
+        for (size_t value = 0; value < bins; ++value) {
+            if (counts[value] > 0) {
+                entropy -= counts[value] / n * std::log2(counts[value] / n);
+            }
+        }
+        return entropy;
+    }
+
+public:
+    FloatFields(uint32_t bits = 32, Endian order = Endian::Little) : bits(bits == 64 ? 64 : 32), order(order), values(0), firstValue(0), lastValue(0), sign{}, exponent(size_t(1) << exponent_bits(), 0), mantissa(size_t(mantissa_bytes()) * BYTE_VAL_COUNT, 0), delta(size_t(this->bits / 8) * BYTE_VAL_COUNT, 0), pending{}, pendingLength(0) {
+    }
+
+    uint32_t get_bits() const {
+        return bits;
+    }
+    Endian get_order() const {
+        return order;
+    }
+
+    size_t alignment() const {
+        return bits / 8;
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        uint32_t valueBytes = bits / 8;
+        size_t i = 0;
+        if (pendingLength > 0) {
+            for (; i < size && pendingLength < valueBytes; ++i) {
+                pending[pendingLength++] = map(bytes[i]);
+            }
+            if (pendingLength == valueBytes) {
+                add_value(value_at(pending.data()));
+                pendingLength = 0;
+            }
+        }
+        for (; i + valueBytes <= size; i += valueBytes) {
+            add_value(value_at(bytes + i, map));
+        }
+        for (; i < size; ++i) {
+            pending[pendingLength++] = map(bytes[i]);
+        }
+    }
+
+    // Appends the accumulation of the bytes directly following, both joined at alignment()
+    void merge(const FloatFields &next) {
+        if (values > 0 && next.values > 0) {
+            add_delta(lastValue ^ next.firstValue);
+        }
+        for (int k = 0; k < 2; ++k) {
+            sign[k] += next.sign[k];
+        }
+        for (size_t k = 0; k < exponent.size(); ++k) {
+            exponent[k] += next.exponent[k];
+        }
+        for (size_t k = 0; k < mantissa.size(); ++k) {
+            mantissa[k] += next.mantissa[k];
+        }
+        for (size_t k = 0; k < delta.size(); ++k) {
+            delta[k] += next.delta[k];
+        }
+        if (values == 0) {
+            firstValue = next.firstValue;
+        }
+        if (next.values > 0) {
+            lastValue = next.lastValue;
+        }
+        values += next.values;
+        pending = next.pending;
+        pendingLength = next.pendingLength;
+    }
+
+    FloatFieldResult result() const {
+        FloatFieldResult result{bits, values, entropy_of(sign.data(), 2), entropy_of(exponent.data(), exponent.size()), {}, std::nan(""), {}};
+        for (uint32_t k = 0; k < mantissa_bytes(); ++k) {
+            result.mantissaEntropy.push_back(entropy_of(mantissa.data() + size_t(k) * BYTE_VAL_COUNT, BYTE_VAL_COUNT));
+        }
+        std::array<uint64_t, BYTE_VAL_COUNT> pooled{};
+        for (uint32_t k = 0; k < bits / 8; ++k) {
+            const uint64_t *table = delta.data() + size_t(k) * BYTE_VAL_COUNT;
+            result.xorByteEntropy.push_back(entropy_of(table, BYTE_VAL_COUNT));
+            for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+                pooled[value] += table[value];
+            }
+        }
+        result.xorEntropy = entropy_of(pooled.data(), BYTE_VAL_COUNT);
+        return result;
+    }
+
+    void serialize(std::ostream &out) const {
+        for (uint64_t value : {uint64_t(bits), uint64_t(order == Endian::Big), values, firstValue, lastValue, uint64_t(pendingLength), sign[0], sign[1]}) {
+            write_u64(out, value);
+        }
+        for (const std::vector<uint64_t> *table : {&exponent, &mantissa, &delta}) {
+            for (uint64_t count : *table) {
+                write_u64(out, count);
+            }
+        }
+        out.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t width = read_u64(in);
+        uint64_t big = read_u64(in);
+        if (!in || (width != 32 && width != 64)) {
+            return false;
+        }
+        *this = FloatFields(uint32_t(width), big ? Endian::Big : Endian::Little);
+        values = read_u64(in);
+        firstValue = read_u64(in);
+        lastValue = read_u64(in);
+        pendingLength = uint32_t(read_u64(in));
+        sign[0] = read_u64(in);
+        sign[1] = read_u64(in);
+        for (std::vector<uint64_t> *table : {&exponent, &mantissa, &delta}) {
+            for (uint64_t &count : *table) {
+                count = read_u64(in);
+            }
+        }
+        in.read(reinterpret_cast<char *>(pending.data()), pending.size());
+        return in && pendingLength < bits / 8;
+    }
+};
+
+// Histograms of the byte delta, the XOR with the previous byte and the XOR with the byte lag
+// positions back, counted from the raw bytes as they stream by, so no transformed copy is
+// made. Bytes lacking a predecessor within a stretch are kept in head, and the last lag bytes
+// in tail, for a preceding and a following stretch to complete them on merge.
+class Transforms {
+private:
+    uint32_t lag;
+    uint64_t length;
+    std::array<uint64_t, BYTE_VAL_COUNT> delta;
+    std::array<uint64_t, BYTE_VAL_COUNT> previous;
+    std::array<uint64_t, BYTE_VAL_COUNT> lagged;
+    std::vector<unsigned char> head;  // The first max_lag() bytes
+    std::vector<unsigned char> tail;  // The last max_lag() bytes
+
+    uint32_t max_lag() const {
+        return std::max<uint32_t>(lag, 1);
+    }
+
+    // Counts byte given the bytes before it, most recent last
+    void count_with_history(unsigned char byte, const std::vector<unsigned char> &history) {
+        size_t size = history.size();
+        if (size >= 1) {
+            delta[uint8_t(byte - history[size - 1])]++;
+            previous[byte ^ history[size - 1]]++;
+        }
+        if (size >= lag) {
+            lagged[byte ^ history[size - lag]]++;
+        }
+    }
+
+    static TransformResult summarize(const std::string &name, uint32_t lag, const std::array<uint64_t, BYTE_VAL_COUNT> &histogram) {
+        uint64_t total = std::accumulate(histogram.begin(), histogram.end(), uint64_t(0));
+        TransformResult result{name, lag, total, std::nan(""), std::nan(""), std::nan(""), std::nan("")};
+        if (total == 0) {
+            return result;
+        }
+        double n = double(total);
+        double expected = n / BYTE_VAL_COUNT;
+        double entropy = 0.0, chisquare = 0.0, sum = 0.0;
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            double count = double(histogram[value]);
+            if (count > 0) {
+                entropy -= count / n * std::log2(count / n);
+            }
+            chisquare += (count - expected) * (count - expected) / expected;
+            sum += double(value) * count;
+        }
+        result.entropy = entropy;
+        result.chisquare = chisquare;
+        result.p_value = chisquare_p(chisquare, BYTE_VAL_COUNT - 1);
+        result.mean = sum / n;
+        return result;
+    }
+
+public:
+    Transforms(uint32_t lag = 4) : lag(std::clamp<uint32_t>(lag, 1, TRANSFORM_MAX_LAG)), length(0), delta{}, previous{}, lagged{}, head(), tail() {
+    }
+
+    uint32_t get_lag() const {
+        return lag;
+    }
+
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, Map map = {}) {
+        size_t reach = max_lag();
+        size_t i = 0;
+        // Bytes whose predecessors lie in earlier updates
+        for (; i < size && i < reach; ++i) {
+            unsigned char byte = map(bytes[i]);
+            if (length + i < reach) {
+                head.push_back(byte);
+            }
+            count_with_history(byte, tail);
+            tail.push_back(byte);
+        }
+        // All three transforms in one branch-free loop over the raw bytes
+        for (; i < size; ++i) {
+            unsigned char byte = map(bytes[i]);
+            delta[uint8_t(byte - map(bytes[i - 1]))]++;
+            previous[byte ^ map(bytes[i - 1])]++;
+            lagged[byte ^ map(bytes[i - lag])]++;
+        }
+        if (size >= reach) {
+            tail.assign(bytes + size - reach, bytes + size);
+            for (unsigned char &byte : tail) {
+                byte = map(byte);
+            }
+        } else if (tail.size() > reach) {
+            tail.erase(tail.begin(), tail.end() - reach);
+        }
+        length += size;
+    }
+
+    // Appends the accumulation of the bytes directly following
+    void merge(const Transforms &next) {
+        size_t reach = max_lag();
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            delta[value] += next.delta[value];
+            previous[value] += next.previous[value];
+            lagged[value] += next.lagged[value];
+        }
+        // The head of next gets the predecessors it lacked from the tail of this: the first
+        // byte its delta and XOR with the previous byte, all of them their lagged XOR
+        std::vector<unsigned char> history = tail;
+        for (size_t i = 0; i < next.head.size(); ++i) {
+            unsigned char byte = next.head[i];
+            if (head.size() < reach) {
+                head.push_back(byte);
+            }
+            if (i == 0 && !history.empty()) {
+                delta[uint8_t(byte - history.back())]++;
+                previous[byte ^ history.back()]++;
+            }
+            if (history.size() >= lag) {
+                lagged[byte ^ history[history.size() - lag]]++;
+            }
+            history.push_back(byte);
+        }
+        // Bytes of next counted in next had all their predecessors in next, so only the
+        // head bytes were missing; when next is shorter than its head the tail follows on
+        if (next.length >= reach) {
+            tail = next.tail;
+        } else {
+            tail.assign(history.end() - std::min(history.size(), reach), history.end());
+        }
+        length += next.length;
+    }
+
+    std::vector<TransformResult> result() const {
+        return {summarize("delta", 1, delta), summarize("xor", 1, previous), summarize("xor", lag, lagged)};
+    }
+
+    void serialize(std::ostream &out) const {
+        write_u64(out, lag);
+        write_u64(out, length);
+        for (const auto *histogram : {&delta, &previous, &lagged}) {
+            for (uint64_t count : *histogram) {
+                write_u64(out, count);
+            }
+        }
+        for (const std::vector<unsigned char> *bytes : {&head, &tail}) {
+            write_u64(out, bytes->size());
+            out.write(reinterpret_cast<const char *>(bytes->data()), bytes->size());
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t savedLag = read_u64(in);
+        if (!in || savedLag == 0 || savedLag > TRANSFORM_MAX_LAG) {
+            return false;
+        }
+        lag = uint32_t(savedLag);
+        length = read_u64(in);
+        for (auto *histogram : {&delta, &previous, &lagged}) {
+            for (uint64_t &count : *histogram) {
+                count = read_u64(in);
+            }
+        }
+        for (std::vector<unsigned char> *bytes : {&head, &tail}) {
+            uint64_t size = read_u64(in);
+            if (!in || size > max_lag()) {
+                return false;
+            }
+            bytes->resize(size);
+            in.read(reinterpret_cast<char *>(bytes->data()), size);
+        }
+        return bool(in);
+    }
+};
+
+// The poker, gap and coupon collector tests of KnuthResult over 1, 2, 4 or 8-bit symbols,
+// most significant first. Five bytes hold a whole number of hands at every width. Gaps go
+// byte by byte through a table of each byte's hits, so the symbols themselves are not
+// branched on. Coupon segments run on from the start of the stream, so they are only known
+// for accumulations that cover it from there.
+class SymbolTests {
+private:
+    struct GapStep {
+        uint8_t hits;
+        uint8_t lead;   // Symbols before the first hit
+        uint8_t trail;  // Symbols after the last hit
+        std::array<uint8_t, 8> gaps;  // Between consecutive hits
+    };
+
+    uint32_t symbolBits;
+    std::array<uint64_t, POKER_HAND> hands;  // By distinct symbols - 1
+    std::vector<uint64_t> gaps;
+    uint64_t leading;  // Symbols before the first hit, all of them while there is none
+    uint64_t trailing;
+    bool hit;
+    std::array<unsigned char, POKER_HAND> pending;
+    uint32_t pendingLength;
+    // Coupon collector: the values seen in the current segment, its length so far and the
+    // completed segments by length. They cover the stream from its start up to byte
+    // couponEnd, while the accumulated bytes end at end; a shard from the middle of the
+    // stream does not know where its segments start, so merging one leaves them short.
+    std::array<uint64_t, BYTE_VAL_COUNT / 64> couponSeen;
+    uint32_t couponFound;
+    uint64_t couponLength;
+    std::vector<uint64_t> coupons;
+    uint64_t couponEnd;
+    uint64_t end;
+
+    const std::array<GapStep, BYTE_VAL_COUNT> &gap_table() const {
+        static const auto tables = [] {
+            std::array<std::array<GapStep, BYTE_VAL_COUNT>, 4> all{};
+            for (int width = 0; width < 4; ++width) {
+                int bits = 1 << width, symbols = 8 / bits;
+                for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+                    GapStep step{};
+                    int last = -1;
+                    for (int i = 0; i < symbols; ++i) {
+                        // A hit is a symbol in the lower half of the alphabet
+                        bool isHit = ((value >> (8 - bits * i - 1)) & 1) == 0;
+                        if (!isHit) {
+                            continue;
+                        }
+                        if (last < 0) {
+                            step.lead = uint8_t(i);
+                        } else {
+                            step.gaps[step.hits - 1] = uint8_t(i - last - 1);
+                        }
+                        step.hits++;
+                        last = i;
+                    }
+                    step.trail = uint8_t(last < 0 ? symbols : symbols - 1 - last);
+                    all[width][value] = step;
+                }
+            }
+            return all;
+        }();
+        return tables[std::countr_zero(symbolBits)];
+    }
+
+    void count_gap(uint64_t length) {
+        gaps[std::min<uint64_t>(length, GAP_LIMIT)]++;
+    }
+
+    // Hands of the 40 bits in five bytes
+    template <typename Map = SameByte>
+    void add_group(const unsigned char *bytes, Map map = {}) {
+        uint64_t bits = 0;
+        for (int k = 0; k < POKER_HAND; ++k) {
+            bits = (bits << 8) | map(bytes[k]);
+        }
+        uint32_t handBits = POKER_HAND * symbolBits;
+        uint32_t mask = (uint32_t(1) << symbolBits) - 1;
+        for (uint32_t shift = 40; shift >= handBits; shift -= handBits) {
+            uint32_t symbol[POKER_HAND];
+            for (int i = 0; i < POKER_HAND; ++i) {
+                symbol[i] = uint32_t(bits >> (shift - symbolBits * (i + 1))) & mask;
+            }
+            // A symbol is new when it differs from all before it
+            int distinct = 1;
+            for (int i = 1; i < POKER_HAND; ++i) {
+                bool isNew = true;
+                for (int j = 0; j < i; ++j) {
+                    isNew &= symbol[i] != symbol[j];
+                }
+                distinct += isNew;
+            }
+            hands[distinct - 1]++;
+        }
+    }
+
+    template <typename Map>
+    void add_gaps(const unsigned char *bytes, size_t size, Map map) {
+        const std::array<GapStep, BYTE_VAL_COUNT> &table = gap_table();
+        uint64_t symbols = 8 / symbolBits;
+        size_t i = 0;
+        // Until the first hit the symbols add to the leading gap
+        for (; i < size && !hit; ++i) {
+            const GapStep &step = table[map(bytes[i])];
+            if (step.hits == 0) {
+                leading += symbols;
+                continue;
+            }
+            leading += step.lead;
+            for (int g = 0; g + 1 < step.hits; ++g) {
+                count_gap(step.gaps[g]);
+            }
+            trailing = step.trail;
+            hit = true;
+        }
+        for (; i < size; ++i) {
+            const GapStep &step = table[map(bytes[i])];
+            if (step.hits == 0) {
+                trailing += symbols;
+                continue;
+            }
+            count_gap(trailing + step.lead);
+            for (int g = 0; g + 1 < step.hits; ++g) {
+                count_gap(step.gaps[g]);
+            }
+            trailing = step.trail;
+        }
+    }
+
+    template <typename Map>
+    void add_coupons(const unsigned char *bytes, size_t size, Map map) {
+        size_t limit = coupon_probabilities(symbolBits).size() - 1;  // Longer segments share a class
+        uint32_t values = uint32_t(1) << symbolBits;
+        uint32_t mask = values - 1;
+        for (size_t i = 0; i < size; ++i) {
+            uint32_t value = map(bytes[i]);
+            for (int shift = 8 - int(symbolBits); shift >= 0; shift -= int(symbolBits)) {
+                uint32_t symbol = (value >> shift) & mask;
+                uint64_t bit = uint64_t(1) << (symbol & 63);
+                couponFound += (couponSeen[symbol >> 6] & bit) == 0;
+                couponSeen[symbol >> 6] |= bit;
+                couponLength++;
+                if (couponFound == values) {
+                    coupons[std::min<uint64_t>(couponLength, limit + 1) - 1]++;
+                    couponSeen = {};
+                    couponFound = 0;
+                    couponLength = 0;
+                }
+            }
+        }
+    }
+
+public:
+    SymbolTests(uint32_t symbolBits = 8) : symbolBits(std::bit_floor(std::clamp<uint32_t>(symbolBits, 1, 8))), hands{}, gaps(GAP_LIMIT + 1, 0), leading(0), trailing(0), hit(false), pending{}, pendingLength(0), couponSeen{}, couponFound(0), couponLength(0), coupons(coupon_probabilities(this->symbolBits).size(), 0), couponEnd(0), end(0) {
+    }
+
+    uint32_t get_symbol_bits() const {
+        return symbolBits;
+    }
+
+    static constexpr size_t alignment() {
+        return POKER_HAND;
+    }
+
+    // Probabilities of 1 to 5 distinct symbols in a hand over an alphabet of 2^bits
+    static std::vector<double> poker_probabilities(uint32_t bits) {
+        static const double stirling[POKER_HAND] = {1, 15, 25, 10, 1};  // S(5, r)
+        double k = std::ldexp(1.0, int(bits));
+        std::vector<double> probability(POKER_HAND);
+        double falling = 1.0;
+        for (int r = 1; r <= POKER_HAND; ++r) {
+            falling *= k - (r - 1);
+            probability[r - 1] = std::max(0.0, stirling[r - 1] * falling / std::pow(k, POKER_HAND));
+        }
+        return probability;
+    }
+
+    // P(a coupon segment is r symbols long) for r from the alphabet size up, from the chance
+    // of j distinct values after r symbols, up to the length that a segment exceeds with
+    // probability below 1e-6; the last class holds all longer segments
+    static const std::vector<double> &coupon_probabilities(uint32_t bits) {
+        static const auto tables = [] {
+            std::array<std::vector<double>, 4> all;
+            for (int width = 0; width < 4; ++width) {
+                uint32_t values = uint32_t(1) << (1 << width);
+                std::vector<double> distinct(values + 1, 0.0);
+                distinct[0] = 1.0;
+                double remaining = 1.0;
+                for (uint64_t r = 1; remaining > 1e-6; ++r) {
+                    all[width].push_back(distinct[values - 1] / values);
+                    remaining -= all[width].back();
+                    for (uint32_t j = values; j > 0; --j) {
+                        distinct[j] = distinct[j] * j / values + distinct[j - 1] * (values - j + 1) / values;
+                    }
+                    distinct[0] = 0.0;
+                    distinct[values] = 0.0;  // Completed segments are counted above
+                }
+                all[width].push_back(std::max(0.0, remaining));
+            }
+            return all;
+        }();
+        return tables[std::countr_zero(bits)];
+    }
+
+    // position is the offset of bytes in the stream
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, uint64_t position, Map map = {}) {
+        add_gaps(bytes, size, map);
+        update_coupons(bytes, size, position, map);
+        size_t i = 0;
+        if (pendingLength > 0) {
+            size_t take = std::min<size_t>(size, POKER_HAND - pendingLength);
+            for (size_t k = 0; k < take; ++k) {
+                pending[pendingLength++] = map(bytes[k]);
+            }
+            i = take;
+            if (pendingLength == POKER_HAND) {
+                add_group(pending.data());
+                pendingLength = 0;
+            }
+        }
+        for (; i + POKER_HAND <= size; i += POKER_HAND) {
+            add_group(bytes + i, map);
+        }
+        for (; i < size; ++i) {
+            pending[pendingLength++] = map(bytes[i]);
+        }
+        end = position + size;
+    }
+
+    // Continues the coupon segments over the bytes at position, from couponEnd on. Bytes the
+    // segments do not reach yet are left out, as their segments cannot be known.
+    template <typename Map = SameByte>
+    void update_coupons(const unsigned char *bytes, size_t size, uint64_t position, Map map = {}) {
+        if (couponEnd >= position && couponEnd < position + size) {
+            add_coupons(bytes + (couponEnd - position), size_t(position + size - couponEnd), map);
+            couponEnd = position + size;
+        }
+    }
+
+    // Takes over the coupon segments of the accumulation directly before this one, so they
+    // carry on through this one as in a single pass
+    void continue_coupons(const SymbolTests &previous) {
+        couponSeen = previous.couponSeen;
+        couponFound = previous.couponFound;
+        couponLength = previous.couponLength;
+        coupons = previous.coupons;
+        couponEnd = previous.couponEnd;
+    }
+
+    // Appends the accumulation of the bytes directly following, both joined at alignment()
+    void merge(const SymbolTests &next) {
+        for (int r = 0; r < POKER_HAND; ++r) {
+            hands[r] += next.hands[r];
+        }
+        for (size_t g = 0; g < gaps.size(); ++g) {
+            gaps[g] += next.gaps[g];
+        }
+        if (!next.hit) {
+            (hit ? trailing : leading) += next.leading;
+        } else {
+            if (hit) {
+                count_gap(trailing + next.leading);
+            } else {
+                leading += next.leading;
+                hit = true;
+            }
+            trailing = next.trailing;
+        }
+        pending = next.pending;
+        pendingLength = next.pendingLength;
+        // Segments that reach the end of next were continued from this; any others stop
+        // short of it and the coupon collector test is undefined
+        if (next.couponEnd == next.end && next.couponEnd >= couponEnd) {
+            continue_coupons(next);
+        }
+        end = next.end;
+    }
+
+    KnuthResult result() const {
+        const double nan = std::nan("");
+        KnuthResult result{symbolBits, 0, nan, nan, 0, nan, nan, 0, nan, nan};
+        std::vector<uint64_t> observed(hands.begin(), hands.end());
+        result.hands = std::accumulate(observed.begin(), observed.end(), uint64_t(0));
+        lumped_chisquare(observed, poker_probabilities(symbolBits), result.pokerChisquare, result.pokerP);
+
+        // The gap before the first hit counts as well, the one after the last is unfinished
+        std::vector<uint64_t> gapCounts = gaps;
+        if (hit) {
+            gapCounts[std::min<uint64_t>(leading, GAP_LIMIT)]++;
+        }
+        std::vector<double> probability(GAP_LIMIT + 1);
+        for (int length = 0; length < GAP_LIMIT; ++length) {
+            probability[length] = std::ldexp(1.0, -(length + 1));
+        }
+        probability[GAP_LIMIT] = std::ldexp(1.0, -GAP_LIMIT);
+        result.gaps = std::accumulate(gapCounts.begin(), gapCounts.end(), uint64_t(0));
+        lumped_chisquare(gapCounts, probability, result.gapChisquare, result.gapP);
+
+        if (couponEnd == end) {
+            result.coupons = std::accumulate(coupons.begin(), coupons.end(), uint64_t(0));
+            lumped_chisquare(coupons, coupon_probabilities(symbolBits), result.couponChisquare, result.couponP);
+        }
+        return result;
+    }
+
+    void serialize(std::ostream &out) const {
+        for (uint64_t value : {uint64_t(symbolBits), leading, trailing, uint64_t(hit), uint64_t(pendingLength)}) {
+            write_u64(out, value);
+        }
+        for (uint64_t count : hands) {
+            write_u64(out, count);
+        }
+        for (uint64_t count : gaps) {
+            write_u64(out, count);
+        }
+        out.write(reinterpret_cast<const char *>(pending.data()), pending.size());
+        for (uint64_t value : {uint64_t(couponFound), couponLength, couponEnd, end}) {
+            write_u64(out, value);
+        }
+        for (uint64_t word : couponSeen) {
+            write_u64(out, word);
+        }
+        // Up to the last nonzero class, long tails of empty classes are left out
+        size_t classes = coupons.size();
+        while (classes > 0 && coupons[classes - 1] == 0) {
+            classes--;
+        }
+        write_u64(out, classes);
+        for (size_t k = 0; k < classes; ++k) {
+            write_u64(out, coupons[k]);
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t bits = read_u64(in);
+        if (!in || bits == 0 || bits > 8 || !std::has_single_bit(bits)) {
+            return false;
+        }
+        *this = SymbolTests(uint32_t(bits));
+        leading = read_u64(in);
+        trailing = read_u64(in);
+        hit = read_u64(in) != 0;
+        pendingLength = uint32_t(read_u64(in));
+        for (uint64_t &count : hands) {
+            count = read_u64(in);
+        }
+        for (uint64_t &count : gaps) {
+            count = read_u64(in);
+        }
+        in.read(reinterpret_cast<char *>(pending.data()), pending.size());
+        if (!in || pendingLength >= POKER_HAND) {
+            return false;
+        }
+        couponFound = uint32_t(read_u64(in));
+        couponLength = read_u64(in);
+        couponEnd = read_u64(in);
+        end = read_u64(in);
+        for (uint64_t &word : couponSeen) {
+            word = read_u64(in);
+        }
+        uint64_t classes = read_u64(in);
+        if (!in || classes > coupons.size() || couponFound >= (uint32_t(1) << symbolBits)) {
+            return false;
+        }
+        for (size_t k = 0; k < classes; ++k) {
+            coupons[k] = read_u64(in);
+        }
+        return bool(in);
+    }
+};
+
+// Optional tests that run inside the streaming pass of State. Their blocks are aligned to
+// the start of the whole stream; alignment() is the byte granularity at which two
+// accumulations can be joined.
+struct StreamTests {
+    std::optional<BitBattery> battery;
+    std::optional<MatrixRank> rank;
+    std::optional<LinearComplexity> linear;
+    std::optional<Universal> universal;
+    std::optional<Patterns> patterns;
+    std::optional<SymbolTests> symbols;
+    std::optional<BitPositions> positions;
+    std::optional<Columns> columns;
+    std::optional<FloatFields> floats;
+    std::optional<Transforms> transforms;
+
+    bool empty() const {
+        return !battery && !rank && !linear && !universal && !patterns && !symbols && !positions && !columns && !floats && !transforms;
+    }
+
+    // Bitwise or of the Tests carried
+    unsigned mask() const {
+        unsigned tests = 0;
+        if (battery) {
+            tests |= TEST_BIT_BATTERY;
+        }
+        if (rank) {
+            tests |= TEST_MATRIX_RANK;
+        }
+        if (linear) {
+            tests |= TEST_LINEAR_COMPLEXITY;
+        }
+        if (universal) {
+            tests |= TEST_UNIVERSAL;
+        }
+        if (patterns) {
+            tests |= TEST_PATTERNS;
+        }
+        if (symbols) {
+            tests |= TEST_KNUTH;
+        }
+        if (positions) {
+            tests |= TEST_BIT_POSITIONS;
+        }
+        if (columns) {
+            tests |= TEST_COLUMNS;
+        }
+        if (floats) {
+            tests |= TEST_FLOAT_FIELDS;
+        }
+        if (transforms) {
+            tests |= TEST_TRANSFORMS;
+        }
+        return tests;
+    }
+
+    size_t alignment() const {
+        size_t unit = 1;
+        if (battery) {
+            unit = std::lcm(unit, battery->alignment());
+        }
+        if (rank) {
+            unit = std::lcm(unit, rank->alignment());
+        }
+        if (linear) {
+            unit = std::lcm(unit, linear->alignment());
+        }
+        if (universal) {
+            unit = std::lcm(unit, universal->alignment());
+        }
+        if (patterns) {
+            unit = std::lcm(unit, patterns->alignment());
+        }
+        if (symbols) {
+            unit = std::lcm(unit, symbols->alignment());
+        }
+        if (floats) {
+            unit = std::lcm(unit, floats->alignment());
+        }
+        return unit;
+    }
+
+    // Same tests with the same parameters
+    bool compatible(const StreamTests &other) const {
+        if (battery.has_value() != other.battery.has_value() || rank.has_value() != other.rank.has_value() || linear.has_value() != other.linear.has_value() || universal.has_value() != other.universal.has_value() || patterns.has_value() != other.patterns.has_value() || symbols.has_value() != other.symbols.has_value() || positions.has_value() != other.positions.has_value() || columns.has_value() != other.columns.has_value() || floats.has_value() != other.floats.has_value() || transforms.has_value() != other.transforms.has_value()) {
+            return false;
+        }
+        if (linear && linear->get_block_bits() != other.linear->get_block_bits()) {
+            return false;
+        }
+        if (universal && universal->get_block_bits() != other.universal->get_block_bits()) {
+            return false;
+        }
+        if (patterns && patterns->get_max_length() != other.patterns->get_max_length()) {
+            return false;
+        }
+        if (symbols && symbols->get_symbol_bits() != other.symbols->get_symbol_bits()) {
+            return false;
+        }
+        if (columns && columns->get_record_size() != other.columns->get_record_size()) {
+            return false;
+        }
+        if (floats && (floats->get_bits() != other.floats->get_bits() || floats->get_order() != other.floats->get_order())) {
+            return false;
+        }
+        if (transforms && transforms->get_lag() != other.transforms->get_lag()) {
+            return false;
+        }
+        return !battery || battery->get_block_bits() == other.battery->get_block_bits();
+    }
+
+    // position is the offset of bytes in the stream, map translates each byte as it is read
+    template <typename Map = SameByte>
+    void update(const unsigned char *bytes, size_t size, uint64_t position, Map map = {}) {
+        if (battery) {
+            battery->update(bytes, size, map);
+        }
+        if (rank) {
+            rank->update(bytes, size, map);
+        }
+        if (linear) {
+            linear->update(bytes, size, map);
+        }
+        if (universal) {
+            universal->update(bytes, size, position, map);
+        }
+        if (patterns) {
+            patterns->update(bytes, size, map);
+        }
+        if (symbols) {
+            symbols->update(bytes, size, position, map);
+        }
+        if (positions) {
+            positions->update(bytes, size, map);
+        }
+        if (columns) {
+            columns->update(bytes, size, position, map);
+        }
+        if (floats) {
+            floats->update(bytes, size, map);
+        }
+        if (transforms) {
+            transforms->update(bytes, size, map);
+        }
+    }
+
+    void merge(const StreamTests &next) {
+        if (battery) {
+            battery->merge(*next.battery);
+        }
+        if (rank) {
+            rank->merge(*next.rank);
+        }
+        if (linear) {
+            linear->merge(*next.linear);
+        }
+        if (universal) {
+            universal->merge(*next.universal);
+        }
+        if (patterns) {
+            patterns->merge(*next.patterns);
+        }
+        if (symbols) {
+            symbols->merge(*next.symbols);
+        }
+        if (positions) {
+            positions->merge(*next.positions);
+        }
+        if (columns) {
+            columns->merge(*next.columns);
+        }
+        if (floats) {
+            floats->merge(*next.floats);
+        }
+        if (transforms) {
+            transforms->merge(*next.transforms);
+        }
+    }
+
+    void serialize(std::ostream &out) const {
+        write_u64(out, (battery ? 1 : 0) | (rank ? 2 : 0) | (linear ? 4 : 0) | (universal ? 8 : 0) | (patterns ? 16 : 0) | (symbols ? 32 : 0) | (positions ? 64 : 0) | (columns ? 128 : 0) | (floats ? 256 : 0) | (transforms ? 512 : 0));
+        if (battery) {
+            battery->serialize(out);
+        }
+        if (rank) {
+            rank->serialize(out);
+        }
+        if (linear) {
+            linear->serialize(out);
+        }
+        if (universal) {
+            universal->serialize(out);
+        }
+        if (patterns) {
+            patterns->serialize(out);
+        }
+        if (symbols) {
+            symbols->serialize(out);
+        }
+        if (positions) {
+            positions->serialize(out);
+        }
+        if (columns) {
+            columns->serialize(out);
+        }
+        if (floats) {
+            floats->serialize(out);
+        }
+        if (transforms) {
+            transforms->serialize(out);
+        }
+    }
+
+    bool deserialize(std::istream &in) {
+        uint64_t present = read_u64(in);
+        battery.reset();
+        rank.reset();
+        linear.reset();
+        universal.reset();
+        patterns.reset();
+        symbols.reset();
+        positions.reset();
+        columns.reset();
+        floats.reset();
+        transforms.reset();
+        if (present & ~uint64_t(1023)) {
+            return false;
+        }
+        if (present & 1) {
+            battery.emplace();
+            if (!battery->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 2) {
+            rank.emplace();
+            if (!rank->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 4) {
+            linear.emplace();
+            if (!linear->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 8) {
+            universal.emplace();
+            if (!universal->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 16) {
+            patterns.emplace();
+            if (!patterns->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 32) {
+            symbols.emplace();
+            if (!symbols->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 64) {
+            positions.emplace();
+            if (!positions->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 128) {
+            columns.emplace();
+            if (!columns->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 256) {
+            floats.emplace();
+            if (!floats->deserialize(in)) {
+                return false;
+            }
+        }
+        if (present & 512) {
+            transforms.emplace();
+            if (!transforms->deserialize(in)) {
+                return false;
+            }
+        }
+        return bool(in);
+    }
+};
+
+// Size and modification time of the file a state was read from, so a checkpoint is not
+// resumed against a file that has changed since
+struct SourceIdentity {
+    uint64_t size = 0;
+    int64_t modified = 0;  // Ticks of the file clock
+
+    bool operator==(const SourceIdentity &) const = default;
+};
+
+// Accumulated sums of one contiguous stretch of the input stream. The state of two
+// adjacent stretches merges into exactly the state of both analyzed in one pass, so
+// shards can be analyzed by separate processes and combined afterwards.
+class State {
+private:
+    static constexpr char MAGIC[4] = {'E', 'N', 'T', 'S'};
+    static constexpr int PI_GROUP = 6;  // Bytes per Monte Carlo (x, y) coordinate pair
+
+    uint64_t offset;
+    uint64_t length;
+    bool foldCase;
+    std::array<uint64_t, BYTE_VAL_COUNT> histogram;
+    uint64_t productSum;  // Sum of products of adjacent bytes
+    uint64_t bitChanges;  // Adjacent bits that differ
+    unsigned char first;
+    unsigned char last;
+    uint64_t piHits;
+    uint64_t piTotal;
+    // Coordinate groups are aligned to the start of the whole stream. Bytes before the
+    // first group boundary (head) and after the last one (tail) are kept for stitching.
+    bool aligned;
+    uint8_t headLength;
+    uint8_t tailLength;
+    std::array<unsigned char, PI_GROUP> head;
+    std::array<unsigned char, PI_GROUP> tail;
+    // Optional tests, fed from the first multiple of their alignment on. Bytes before
+    // that are kept in testsHead so a preceding state can complete its blocks with them.
+    StreamTests tests;
+    bool testsAligned;
+    std::vector<unsigned char> testsHead;
+    std::optional<SourceIdentity> source;  // Unknown unless set
+
+    template <typename Map>
+    void update_tests(const unsigned char *bytes, size_t size, uint64_t position, Map map) {
+        size_t i = 0;
+        if (!testsAligned) {
+            size_t unit = tests.alignment();
+            for (; i < size && (position + i) % unit != 0; ++i) {
+                testsHead.push_back(map(bytes[i]));
+            }
+            testsAligned = (position + i) % unit == 0;
+            // Continued coupon segments need no block alignment
+            if (tests.symbols) {
+                tests.symbols->update_coupons(bytes, i, position, map);
+            }
+        }
+        tests.update(bytes + i, size - i, position + i, map);
+    }
+
+    void count_pi_group(const unsigned char *group) {
+        uint64_t x = uint64_t(group[0]) << 16 | uint64_t(group[1]) << 8 | group[2];
+        uint64_t y = uint64_t(group[3]) << 16 | uint64_t(group[4]) << 8 | group[5];
+        if (x * x + y * y < (uint64_t(1) << 48)) {
+            piHits++;
+        }
+        piTotal++;
+    }
+
+    template <typename Map>
+    void update_mapped(const unsigned char *bytes, size_t size, Map map) {
+        std::array<uint64_t, 4 * BYTE_VAL_COUNT> partial{};
+        uint64_t products = 0;
+        uint64_t changes = 0;
+        unsigned char previous = length > 0 ? last : map(bytes[0]);
+        if (length == 0) {
+            first = previous;
+            products -= uint64_t(first) * first;  // The first byte has no predecessor
+            changes -= ((first >> 7) ^ first) & 1;
+        }
+        auto add = [&](unsigned char byte, int lane) {
+            partial[lane * BYTE_VAL_COUNT + byte]++;
+            products += uint64_t(previous) * byte;
+            // The eight bits of byte, each against the bit before it
+            unsigned bits = unsigned(previous & 1) << 8 | byte;
+            changes += std::popcount((bits ^ (bits >> 1)) & 0xFFu);
+            previous = byte;
+        };
+
+        // Bytes up to the next group boundary complete the head or the pending tail
+        size_t i = 0;
+        uint64_t position = offset + length;
+        if (!aligned) {
+            for (; i < size && (position + i) % PI_GROUP != 0; ++i) {
+                head[headLength++] = map(bytes[i]);
+                add(head[headLength - 1], 0);
+            }
+            aligned = (position + i) % PI_GROUP == 0;
+        } else {
+            for (; i < size && tailLength > 0; ++i) {
+                tail[tailLength++] = map(bytes[i]);
+                add(tail[tailLength - 1], 0);
+                if (tailLength == PI_GROUP) {
+                    count_pi_group(tail.data());
+                    tailLength = 0;
+                }
+            }
+        }
+
+        // One fused pass for the histogram, the adjacent products and complete coordinate groups
+        for (; i + PI_GROUP <= size; i += PI_GROUP) {
+            unsigned char group[PI_GROUP];
+            for (int k = 0; k < PI_GROUP; ++k) {
+                group[k] = map(bytes[i + k]);
+                add(group[k], k & 3);
+            }
+            count_pi_group(group);
+        }
+        for (; i < size; ++i) {
+            tail[tailLength++] = map(bytes[i]);
+            add(tail[tailLength - 1], 0);
+        }
+
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            histogram[value] += partial[value] + partial[BYTE_VAL_COUNT + value] + partial[2 * BYTE_VAL_COUNT + value] + partial[3 * BYTE_VAL_COUNT + value];
+        }
+        productSum += products;
+        bitChanges += changes;
+        last = previous;
+        length += size;
+    }
+
+    // Case folding is applied by map inside every accumulator, the bytes are never copied
+    template <typename Map>
+    void update_with(std::span<const unsigned char> bytes, Map map) {
+        if (bytes.empty()) {
+            return;
+        }
+        if (tests.empty()) {
+            update_mapped(bytes.data(), bytes.size(), map);
+            return;
+        }
+
+        // Cache sized blocks go through all accumulators in turn, so the data is read once
+        for (size_t i = 0; i < bytes.size(); i += STREAM_BLOCK_SIZE) {
+            size_t size = std::min<size_t>(STREAM_BLOCK_SIZE, bytes.size() - i);
+            uint64_t position = offset + length;
+            update_mapped(bytes.data() + i, size, map);
+            update_tests(bytes.data() + i, size, position, map);
+        }
+    }
+
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    // offset is the position of the first byte of this stretch in the whole stream,
+    // tests selects the optional tests accumulated along with the basic sums
+    State(uint64_t offset = 0, bool foldCase = false, const StreamTests &tests = StreamTests()) : offset(offset), length(0), foldCase(foldCase), histogram{}, productSum(0), bitChanges(0), first(0), last(0), piHits(0), piTotal(0), aligned(offset % PI_GROUP == 0), headLength(0), tailLength(0), head{}, tail{}, tests(tests), testsAligned(offset % this->tests.alignment() == 0) {
+    }
+
+    // Appends bytes that directly follow the ones already accumulated
+    void update(std::span<const unsigned char> bytes) {
+        if (foldCase) {
+            update_with(bytes, FoldedByte());
+        } else {
+            update_with(bytes, SameByte());
+        }
+    }
+
+    // Continues the coupon segments of the symbol tests, which only a single pass can
+    // follow, over bytes at position. See SymbolTests::update_coupons().
+    void update_coupons(std::span<const unsigned char> bytes, uint64_t position) {
+        if (!tests.symbols) {
+            return;
+        }
+        if (foldCase) {
+            tests.symbols->update_coupons(bytes.data(), bytes.size(), position, FoldedByte());
+        } else {
+            tests.symbols->update_coupons(bytes.data(), bytes.size(), position, SameByte());
+        }
+    }
+
+    // Appends count zero bytes, such as a hole in a sparse file, without reading them. The
+    // basic sums are updated in closed form; the optional tests are fed blocks of zeros.
+    void update_zeros(uint64_t count) {
+        if (!tests.empty()) {
+            static const std::vector<unsigned char> zeros(STREAM_BLOCK_SIZE, 0);
+            for (; count > 0; count -= std::min<uint64_t>(count, zeros.size())) {
+                update(std::span<const unsigned char>(zeros.data(), std::min<uint64_t>(count, zeros.size())));
+            }
+            return;
+        }
+
+        // Zeros completing a coordinate group go through the byte kernel
+        static const unsigned char zero = 0;
+        for (; count > 0 && (!aligned || tailLength > 0); --count) {
+            update_mapped(&zero, 1, SameByte());
+        }
+        if (count == 0) {
+            return;
+        }
+        if (length == 0) {
+            first = 0;
+        } else {
+            bitChanges += last & 1;  // Only the first zero can differ from the bit before it
+        }
+        // Zero products add nothing, and every all-zero group is a point inside the circle
+        histogram[0] += count;
+        piHits += count / PI_GROUP;
+        piTotal += count / PI_GROUP;
+        tailLength = uint8_t(count % PI_GROUP);
+        std::fill(tail.begin(), tail.begin() + tailLength, 0);
+        last = 0;
+        length += count;
+    }
+
+    // Appends the state of the stretch that directly follows this one. Returns false,
+    // leaving this state unchanged, if the stretches are not adjacent or were folded differently.
+    bool merge(const State &next) {
+        if (next.offset != offset + length || next.foldCase != foldCase || !tests.compatible(next.tests)) {
+            return false;
+        }
+        if (next.length == 0) {
+            return true;
+        }
+        if (length == 0) {
+            *this = next;
+            return true;
+        }
+
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            histogram[value] += next.histogram[value];
+        }
+        productSum += next.productSum + uint64_t(last) * next.first;
+        bitChanges += next.bitChanges + ((last ^ (next.first >> 7)) & 1);
+        last = next.last;
+        if (source != next.source) {
+            source.reset();
+        }
+        piHits += next.piHits;
+        piTotal += next.piTotal;
+
+        if (!aligned) {
+            // Everything so far precedes the first group boundary
+            for (int k = 0; k < next.headLength; ++k) {
+                head[headLength++] = next.head[k];
+            }
+            aligned = next.aligned;
+            tail = next.tail;
+            tailLength = next.tailLength;
+        } else {
+            for (int k = 0; k < next.headLength; ++k) {
+                tail[tailLength++] = next.head[k];
+            }
+            if (tailLength == PI_GROUP) {
+                count_pi_group(tail.data());
+                tailLength = 0;
+            }
+            if (next.aligned) {
+                tail = next.tail;
+                tailLength = next.tailLength;
+            }
+        }
+
+        if (!tests.empty()) {
+            if (!testsAligned) {
+                testsHead.insert(testsHead.end(), next.testsHead.begin(), next.testsHead.end());
+                if (next.testsAligned) {
+                    tests = next.tests;
+                    testsAligned = true;
+                }
+            } else {
+                // The head of next completes the blocks this state has pending
+                tests.update(next.testsHead.data(), next.testsHead.size(), next.offset);
+                if (next.testsAligned) {
+                    tests.merge(next.tests);
+                }
+            }
+        }
+        length += next.length;
+        return true;
+    }
+
+    // Writes a versioned little-endian binary image of the state
+    void serialize(std::ostream &out) const {
+        out.write(MAGIC, 4);
+        write_u64(out, VERSION);
+        write_u64(out, offset);
+        write_u64(out, length);
+        write_u64(out, (foldCase ? 1 : 0) | (aligned ? 2 : 0));
+        for (auto count : histogram) {
+            write_u64(out, count);
+        }
+        write_u64(out, productSum);
+        write_u64(out, piHits);
+        write_u64(out, piTotal);
+        unsigned char bytes[4 + 2 * PI_GROUP] = {first, last, headLength, tailLength};
+        std::copy(head.begin(), head.end(), bytes + 4);
+        std::copy(tail.begin(), tail.end(), bytes + 4 + PI_GROUP);
+        out.write(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+        tests.serialize(out);
+        write_u64(out, testsAligned ? 1 : 0);
+        write_u64(out, testsHead.size());
+        out.write(reinterpret_cast<const char *>(testsHead.data()), testsHead.size());
+        write_u64(out, bitChanges);
+        write_u64(out, source ? 1 : 0);
+        write_u64(out, source ? source->size : 0);
+        write_u64(out, source ? uint64_t(source->modified) : 0);
+    }
+
+    // Reads a state written by serialize(). Returns false on a malformed image or an unknown version.
+    bool deserialize(std::istream &in) {
+        char magic[4] = {};
+        in.read(magic, 4);
+        if (!in || !std::equal(magic, magic + 4, MAGIC)) {
+            return false;
+        }
+        uint64_t version = read_u64(in);
+        if (version != VERSION) {
+            return false;
+        }
+        State state;
+        state.offset = read_u64(in);
+        state.length = read_u64(in);
+        uint64_t flags = read_u64(in);
+        state.foldCase = flags & 1;
+        state.aligned = flags & 2;
+        for (auto &count : state.histogram) {
+            count = read_u64(in);
+        }
+        state.productSum = read_u64(in);
+        state.piHits = read_u64(in);
+        state.piTotal = read_u64(in);
+        unsigned char bytes[4 + 2 * PI_GROUP] = {};
+        in.read(reinterpret_cast<char *>(bytes), sizeof(bytes));
+        if (!in || bytes[2] >= PI_GROUP || bytes[3] >= PI_GROUP) {
+            return false;
+        }
+        state.first = bytes[0];
+        state.last = bytes[1];
+        state.headLength = bytes[2];
+        state.tailLength = bytes[3];
+        std::copy(bytes + 4, bytes + 4 + PI_GROUP, state.head.begin());
+        std::copy(bytes + 4 + PI_GROUP, bytes + 4 + 2 * PI_GROUP, state.tail.begin());
+        if (!state.tests.deserialize(in)) {
+            return false;
+        }
+        state.testsAligned = read_u64(in) != 0;
+        uint64_t headSize = read_u64(in);
+        if (!in || headSize > state.tests.alignment()) {
+            return false;
+        }
+        state.testsHead.resize(headSize);
+        in.read(reinterpret_cast<char *>(state.testsHead.data()), headSize);
+        state.bitChanges = read_u64(in);
+        bool known = read_u64(in) != 0;
+        SourceIdentity identity;
+        identity.size = read_u64(in);
+        identity.modified = int64_t(read_u64(in));
+        if (!in) {
+            return false;
+        }
+        if (known) {
+            state.source = identity;
+        }
+        *this = state;
+        return true;
+    }
+
+    // Saves the state to path with replace_file(), so a crash leaves either the previous
+    // or the new checkpoint behind, never a partial one.
+    bool save(const std::string &path) const {
+        std::ostringstream image;
+        serialize(image);
+        return replace_file(path, image.str());
+    }
+
+    bool load(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        return in && deserialize(in);
+    }
+
+    uint64_t get_offset() const {
+        return offset;
+    }
+    uint64_t get_length() const {
+        return length;
+    }
+    bool get_fold_case() const {
+        return foldCase;
+    }
+    const std::array<uint64_t, BYTE_VAL_COUNT> &get_histogram() const {
+        return histogram;
+    }
+    uint64_t get_product_sum() const {
+        return productSum;
+    }
+    uint64_t get_bit_changes() const {
+        return bitChanges;
+    }
+    unsigned char get_first() const {
+        return first;
+    }
+    unsigned char get_last() const {
+        return last;
+    }
+    uint64_t get_pi_hits() const {
+        return piHits;
+    }
+    uint64_t get_pi_total() const {
+        return piTotal;
+    }
+    const StreamTests &get_tests() const {
+        return tests;
+    }
+    std::optional<SourceIdentity> get_source() const {
+        return source;
+    }
+
+    // Records the file the stretch was read from. A merge keeps it only if both states
+    // carry the same one.
+    void set_source(std::optional<SourceIdentity> identity) {
+        source = identity;
+    }
+};
+
+// The bytes under analysis: either read into buffer, from a file or stdin, or viewed in
+// place when caller owned. A copy or move of owned bytes views its own buffer.
+class Input {
+protected:
+    std::vector<unsigned char> buffer;  // Owned input, empty when the bytes are caller owned
+    std::span<const unsigned char> data;  // The bytes under analysis, buffer or caller owned
+
+    Input() = default;
+
+    Input(const Input &other) : buffer(other.buffer), data(other.buffer.empty() ? other.data : std::span<const unsigned char>(buffer)) {
+    }
+
+    Input(Input &&other) noexcept : buffer(std::move(other.buffer)), data(other.data) {
+        other.buffer.clear();
+        other.data = {};
+    }
+
+    Input &operator=(const Input &other) {
+        if (this != &other) {
+            buffer = other.buffer;
+            data = other.buffer.empty() ? other.data : std::span<const unsigned char>(buffer);
+        }
+        return *this;
+    }
+
+    Input &operator=(Input &&other) noexcept {
+        if (this != &other) {
+            // A moved vector keeps its storage, so the view stays valid
+            buffer = std::move(other.buffer);
+            data = other.data;
+            other.buffer.clear();
+            other.data = {};
+        }
+        return *this;
+    }
+};
+
+template <typename Policy = Options<>>
+class BasicEnt : private Input {
+private:
+    std::optional<State> loadedState;  // Set when analyzing merged shard state instead of data
+    double entropy = 0.0;
+    double compression = 0.0;
+    double chisquare = 0.0;
+    double p_value = 0.0;
+    double mean = 0.0;
+    double pi_estimate = 0.0;
+    double serial_correlation = 0.0;
+    double lz_size = 0.0;
+    double lz_compression = 0.0;
+    BitBatteryResult bitBattery = BitBattery().result();
+    std::vector<double> autocorrelation;  // Lags 1 to autocorrelationLags
+    SpectralResult spectral = {0, 0, std::nan(""), std::nan(""), std::nan(""), std::nan("")};
+    MatrixRankResult matrixRank = MatrixRank().result();
+    LinearComplexityResult linearComplexity = LinearComplexity().result();
+    UniversalResult universal = Universal().result();
+    std::vector<PatternResult> patterns;  // m = 2 to patternLength
+    BirthdayResult birthday = {0, 0, 0, std::nan(""), 0, std::nan("")};
+    KnuthResult knuth = SymbolTests().result();
+    std::vector<BitPositionResult> bitPositions;  // By bit position, 0 the least significant
+    std::vector<ColumnResult> columns;  // By offset within the record
+    FloatFieldResult floatFields = FloatFields().result();
+    std::vector<TransformResult> transforms = Transforms().result();  // Byte delta, XOR with the previous byte, XOR with the byte transformLag back
+    bool streamOfBitsMode = false;
+    bool printTableMode = false;
+    bool foldCaseMode = false;
+    bool terseMode = false;
+    bool printResultMode = true;
+    bool lazyMode = false;
+    size_t lzSampleStride = 1;
+    std::string checkpointPath;
+    uint64_t checkpointInterval = 0;
+    bool resumeMode = false;
+    unsigned testMask = DEFAULT_TEST_MASK;
+    unsigned computedTests = 0;
+    std::array<uint64_t, BYTE_VAL_COUNT> histogram;
+    bool histogramReady = false;
+    std::vector<uint64_t> symbolHistogram;  // Symbols of up to SYMBOL_DENSE_BITS bits
+    std::vector<std::pair<uint32_t, uint64_t>> symbolRuns;  // Wider symbols that occur, with their counts
+    bool symbolHistogramReady = false;
+    uint32_t blockFrequencyBits = 128;
+    size_t autocorrelationLags = 4096;
+    uint32_t spectralBlockBits = 1 << 16;
+    uint32_t linearComplexityBits = 512;
+    uint32_t universalBits = 0;  // 0 chooses L from the length of the input
+    uint32_t patternLength = 10;
+    uint32_t birthdaySampleBits = 32;
+    uint32_t knuthSymbolBits = 8;
+    uint32_t recordSize = 16;
+    uint32_t floatBits = 32;
+    Endian floatOrder = Endian::Little;
+    uint32_t transformLag = 4;
+    std::optional<State> fusedState;  // Pass of the tests that run inside State
+
+    static constexpr bool has_test(unsigned test) {
+        return (Policy::tests & test) != 0;
+    }
+
+    // Core statistics over symbols other than bytes
+    static constexpr bool symbol_mode() {
+        return Policy::symbolBits != 8;
+    }
+
+    // Constant for a compile-time sampling policy, so the other branch is dropped
+    bool bit_mode() const {
+        if constexpr (Policy::sampling == Sampling::Runtime) {
+            return streamOfBitsMode;
+        } else {
+            return Policy::sampling == Sampling::Bits;
+        }
+    }
+
+    // Selected both by the policy and by the runtime test mask
+    bool selected(unsigned test) const {
+        return has_test(test) && (testMask & test) != 0;
+    }
+
+    uint64_t byte_count() const {
+        return loadedState ? loadedState->get_length() : data.size();
+    }
+
+    // Forgets memoized results, e.g. after a mode change
+    void invalidate() {
+        computedTests = 0;
+        histogramReady = false;
+        symbolHistogramReady = false;
+        fusedState.reset();
+    }
+
+    // The optional tests selected for the streaming pass of a stream of totalBytes bytes,
+    // with the tests in extra as well
+    StreamTests stream_tests(uint64_t totalBytes, unsigned extra = 0) const {
+        auto wanted = [&](unsigned test) { return has_test(test) && ((testMask | extra) & test) != 0; };
+        StreamTests tests;
+        if (wanted(TEST_BIT_BATTERY)) {
+            tests.battery.emplace(blockFrequencyBits);
+        }
+        if (wanted(TEST_MATRIX_RANK)) {
+            tests.rank.emplace();
+        }
+        if (wanted(TEST_LINEAR_COMPLEXITY)) {
+            tests.linear.emplace(linearComplexityBits);
+        }
+        if (wanted(TEST_UNIVERSAL)) {
+            tests.universal.emplace(universalBits ? universalBits : Universal::block_bits_for(8 * totalBytes));
+        }
+        if (wanted(TEST_PATTERNS)) {
+            tests.patterns.emplace(patternLength);
+        }
+        if (wanted(TEST_KNUTH)) {
+            tests.symbols.emplace(knuthSymbolBits);
+        }
+        if (wanted(TEST_BIT_POSITIONS) && !symbol_mode()) {
+            tests.positions.emplace();
+        }
+        if (wanted(TEST_COLUMNS)) {
+            tests.columns.emplace(recordSize);
+        }
+        if (wanted(TEST_FLOAT_FIELDS)) {
+            tests.floats.emplace(floatBits, floatOrder);
+        }
+        if (wanted(TEST_TRANSFORMS)) {
+            tests.transforms.emplace(transformLag);
+        }
+        return tests;
+    }
+
+    // Accumulates bytes into a State, in parallel over segments aligned for the tests
+    State accumulate(std::span<const unsigned char> bytes, uint64_t offset, const StreamTests &tests) const {
+        size_t parts = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), bytes.size() / LZ_BLOCK_SIZE));
+        size_t unit = tests.alignment();
+        size_t partSize = ((bytes.size() + parts - 1) / parts + unit - 1) / unit * unit;
+        std::vector<State> partial;
+        for (size_t i = 0; i < parts; ++i) {
+            partial.emplace_back(offset + std::min(bytes.size(), i * partSize), foldCaseMode, tests);
+        }
+        parallel_for(parts, [&](size_t i) {
+            size_t begin = std::min(bytes.size(), i * partSize);
+            size_t end = std::min(bytes.size(), begin + partSize);
+            partial[i].update(bytes.subspan(begin, end - begin));
+            if (i == 0 && parts > 1) {
+                // The other parts cannot know where their coupon segments start
+                partial[0].update_coupons(bytes, offset);
+            }
+        });
+        State state = partial[0];
+        for (size_t i = 1; i < parts; ++i) {
+            state.merge(partial[i]);
+        }
+        return state;
+    }
+
+    // One pass over the data for the tests that run inside State, including test
+    const State &fused_state(unsigned test) {
+        if (loadedState) {
+            return *loadedState;
+        }
+        StreamTests tests = stream_tests(data.size(), test);
+        if (!fusedState || !fusedState->get_tests().compatible(tests)) {
+            fusedState = accumulate(data, 0, tests);
+        }
+        return *fusedState;
+    }
+
+    // Runs a test on first use, later requests reuse the memoized result
+    void ensure(unsigned test) {
+        if (computedTests & test) {
+            return;
+        }
+        if constexpr (has_test(TEST_ENTROPY)) {
+            if (test == TEST_ENTROPY) {
+                calculate_entropy();
+            }
+        }
+        if constexpr (has_test(TEST_CHISQUARE)) {
+            if (test == TEST_CHISQUARE) {
+                calculate_chisquare();
+            }
+        }
+        if constexpr (has_test(TEST_MEAN)) {
+            if (test == TEST_MEAN) {
+                calculate_mean();
+            }
+        }
+        if constexpr (has_test(TEST_PI)) {
+            if (test == TEST_PI) {
+                calculate_pi();
+            }
+        }
+        if constexpr (has_test(TEST_SERIAL_CORRELATION)) {
+            if (test == TEST_SERIAL_CORRELATION) {
+                calculate_serial_correlation();
+            }
+        }
+        if constexpr (has_test(TEST_LZ)) {
+            if (test == TEST_LZ) {
+                calculate_lz_compression();
+            }
+        }
+        if constexpr (has_test(TEST_BIT_BATTERY)) {
+            if (test == TEST_BIT_BATTERY) {
+                calculate_bit_battery();
+            }
+        }
+        if constexpr (has_test(TEST_AUTOCORRELATION)) {
+            if (test == TEST_AUTOCORRELATION) {
+                calculate_autocorrelation();
+            }
+        }
+        if constexpr (has_test(TEST_SPECTRAL)) {
+            if (test == TEST_SPECTRAL) {
+                calculate_spectral();
+            }
+        }
+        if constexpr (has_test(TEST_MATRIX_RANK)) {
+            if (test == TEST_MATRIX_RANK) {
+                calculate_matrix_rank();
+            }
+        }
+        if constexpr (has_test(TEST_LINEAR_COMPLEXITY)) {
+            if (test == TEST_LINEAR_COMPLEXITY) {
+                calculate_linear_complexity();
+            }
+        }
+        if constexpr (has_test(TEST_UNIVERSAL)) {
+            if (test == TEST_UNIVERSAL) {
+                calculate_universal();
+            }
+        }
+        if constexpr (has_test(TEST_PATTERNS)) {
+            if (test == TEST_PATTERNS) {
+                calculate_patterns();
+            }
+        }
+        if constexpr (has_test(TEST_BIRTHDAY)) {
+            if (test == TEST_BIRTHDAY) {
+                calculate_birthday();
+            }
+        }
+        if constexpr (has_test(TEST_KNUTH)) {
+            if (test == TEST_KNUTH) {
+                calculate_knuth();
+            }
+        }
+        if constexpr (has_test(TEST_BIT_POSITIONS)) {
+            if (test == TEST_BIT_POSITIONS) {
+                calculate_bit_positions();
+            }
+        }
+        if constexpr (has_test(TEST_COLUMNS)) {
+            if (test == TEST_COLUMNS) {
+                calculate_columns();
+            }
+        }
+        if constexpr (has_test(TEST_FLOAT_FIELDS)) {
+            if (test == TEST_FLOAT_FIELDS) {
+                calculate_float_fields();
+            }
+        }
+        if constexpr (has_test(TEST_TRANSFORMS)) {
+            if (test == TEST_TRANSFORMS) {
+                calculate_transforms();
+            }
+        }
+        computedTests |= test;
+    }
+
+    // Calls kernel with the byte translation in effect. Case folding is applied on the fly
+    // and the data itself is never modified; the identity map gets its own instantiation.
+    template <typename F>
+    auto with_byte_map(F kernel) const {
+        if (foldCaseMode) {
+            return kernel(FoldedByte());
+        }
+        return kernel(SameByte());
+    }
+
+    // Reads the whole file into memory, holes of sparse files included; scanFile() skips them
+    std::vector<unsigned char> load_file_data(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    }
+
+    void print_result() {
+        if constexpr (symbol_mode()) {
+            print_symbol_result();
+            return;
+        }
+        bool bits = bit_mode();
+        std::string samp = bits ? "bit" : "byte";
+        if (selected(TEST_ENTROPY)) {
+            std::cout << "Entropy = " + std::to_string(entropy) + " bits per " + samp + ".\n\n";
+            std::cout << "Optimum compression would reduce the size\nof this " + std::to_string(int(byte_count()*(bits ? 8.0 : 1.0))) + " " + samp + " file by " + std::to_string((int) ((100 * ((bits ? 1 : 8) - entropy) / (bits ? 1.0 : 8.0)))) + " percent.\n\n";
+        }
+        if (selected(TEST_LZ)) {
+            print_lz();
+        }
+        if (selected(TEST_CHISQUARE)) {
+            std::cout << "Chi square distribution for " + std::to_string(int(byte_count()*(bits ? 8.0 : 1.0))) + " samples is " + std::to_string(chisquare) + ", and randomly\n";
+            if (p_value < 0.0001) {
+                std::cout << "would exceed this value less than 0.01 percent of the times.\n\n";
+            } else if (p_value > 0.9999) {
+                std::cout << "would exceed this value more than than 99.99 percent of the times.\n\n";
+            } else {
+                std::cout << "would exceed this value " + std::to_string(p_value * 100) + " percent of the times.\n\n";
+            }
+        }
+        if (selected(TEST_MEAN)) {
+            std::cout << "Arithmetic mean value of data " + std::string(bits ? "bits" : "bytes") + " is " + std::to_string(mean) + " (" + std::to_string(bits ? 0.5 : 127.5) + " = random).\n";
+        }
+        if (selected(TEST_PI)) {
+            std::cout << "Monte Carlo value for Pi is " + std::to_string(pi_estimate) + " (error " + std::to_string(std::fabs(pi_estimate - M_PI) / M_PI * 100.0) + " percent).\n";
+        }
+        if (selected(TEST_SERIAL_CORRELATION)) {
+            std::cout << "Serial correlation coefficient is ";
+            if (serial_correlation >= -99999) {
+                std::cout << std::to_string(serial_correlation) + " (totally uncorrelated = 0.0).\n";
+            } else {
+                std::cout << "undefined (all values equal!).\n";
+            }
+        }
+        print_optional_results();
+    }
+
+    void print_lz() {
+        if (std::isnan(lz_size)) {
+            std::cout << "LZ-style compression estimate is undefined (no byte data in memory).\n\n";
+            return;
+        }
+        std::cout << "LZ-style compression would reduce the size\nof this " + std::to_string(byte_count()) + " byte file by " + std::to_string((int) lz_compression) + " percent (estimated " + std::to_string((long long) lz_size) + " bytes).\n\n";
+    }
+
+    void print_symbol_result() {
+        std::string samp = std::to_string(Policy::symbolBits) + "-bit symbol";
+        uint64_t samples = symbol_count();
+        if (selected(TEST_ENTROPY)) {
+            std::cout << "Entropy = " + std::to_string(entropy) + " bits per " + samp + ".\n\n";
+            std::cout << "Optimum compression would reduce the size\nof this " + std::to_string(samples) + " " + samp + " file by " + std::to_string((int) compression) + " percent.\n\n";
+        }
+        if (selected(TEST_LZ)) {
+            print_lz();
+        }
+        if (selected(TEST_CHISQUARE)) {
+            std::cout << "Chi square distribution for " + std::to_string(samples) + " samples is " + std::to_string(chisquare) + ", and randomly\n";
+            if (p_value < 0.0001) {
+                std::cout << "would exceed this value less than 0.01 percent of the times.\n\n";
+            } else if (p_value > 0.9999) {
+                std::cout << "would exceed this value more than than 99.99 percent of the times.\n\n";
+            } else {
+                std::cout << "would exceed this value " + std::to_string(p_value * 100) + " percent of the times.\n\n";
+            }
+        }
+        if (selected(TEST_MEAN)) {
+            std::cout << "Arithmetic mean value of data symbols is " + std::to_string(mean) + " (" + std::to_string((std::ldexp(1.0, int(Policy::symbolBits)) - 1.0) / 2.0) + " = random).\n";
+        }
+        if (selected(TEST_PI)) {
+            std::cout << "Monte Carlo value for Pi is " + std::to_string(pi_estimate) + " (error " + std::to_string(std::fabs(pi_estimate - M_PI) / M_PI * 100.0) + " percent).\n";
+        }
+        if (selected(TEST_SERIAL_CORRELATION)) {
+            std::cout << "Serial correlation coefficient is ";
+            if (serial_correlation >= -99999) {
+                std::cout << std::to_string(serial_correlation) + " (totally uncorrelated = 0.0).\n";
+            } else {
+                std::cout << "undefined (all values equal!).\n";
+            }
+        }
+        print_optional_results();
+    }
+
+    // Tests beyond the five of the original report
+    void print_optional_results() {
+        if (selected(TEST_BIT_BATTERY)) {
+            print_bit_battery();
+        }
+        if (selected(TEST_AUTOCORRELATION)) {
+            print_autocorrelation();
+        }
+        if (selected(TEST_SPECTRAL)) {
+            print_spectral();
+        }
+        if (selected(TEST_MATRIX_RANK)) {
+            print_matrix_rank();
+        }
+        if (selected(TEST_LINEAR_COMPLEXITY)) {
+            print_linear_complexity();
+        }
+        if (selected(TEST_UNIVERSAL)) {
+            print_universal();
+        }
+        if (selected(TEST_PATTERNS) && !patterns.empty()) {
+            print_patterns();
+        }
+        if (selected(TEST_BIRTHDAY)) {
+            print_birthday();
+        }
+        if (selected(TEST_KNUTH)) {
+            print_knuth();
+        }
+        if (selected(TEST_BIT_POSITIONS) && !bitPositions.empty()) {
+            print_bit_positions();
+        }
+        if (selected(TEST_COLUMNS) && !columns.empty()) {
+            print_columns();
+        }
+        if (selected(TEST_FLOAT_FIELDS)) {
+            print_float_fields();
+        }
+        if (selected(TEST_TRANSFORMS)) {
+            print_transforms();
+        }
+    }
+
+    void print_transforms() {
+        std::cout << "\n";
+        for (const TransformResult &r : transforms) {
+            std::string name = r.name == "delta" ? "Byte delta" : r.lag == 1 ? "XOR with the previous byte" : "XOR with the byte " + std::to_string(r.lag) + " back";
+            std::cout << name + " has entropy " + std::to_string(r.entropy) + " bits per byte, chi square " + std::to_string(r.chisquare) + " (p-value " + std::to_string(r.p_value) + "), mean " + std::to_string(r.mean) + ".\n";
+        }
+    }
+
+    void print_float_fields() {
+        const FloatFieldResult &r = floatFields;
+        auto list = [](const std::vector<double> &entropies) {
+            std::string text;
+            for (double entropy : entropies) {
+                text += (text.empty() ? "" : ", ") + std::to_string(entropy);
+            }
+            return text;
+        };
+        std::cout << "\nFields of " + std::to_string(r.values) + " float" + std::to_string(r.bits) + " values: sign entropy " + std::to_string(r.signEntropy) + ", exponent " + std::to_string(r.exponentEntropy) + " bits,\n";
+        std::cout << "mantissa bytes " + list(r.mantissaEntropy) + " bits.\n";
+        std::cout << "XOR with the previous value has " + std::to_string(r.xorEntropy) + " bits per byte, by byte " + list(r.xorByteEntropy) + ".\n";
+    }
+
+    void print_columns() {
+        std::cout << "\nColumns of " + std::to_string(columns.size()) + "-byte records:\n";
+        for (const ColumnResult &r : columns) {
+            std::cout << "Column " + std::to_string(r.column) + ": entropy " + std::to_string(r.entropy) + " bits per byte, chi square " + std::to_string(r.chisquare) + " (p-value " + std::to_string(r.p_value) + "), mean " + std::to_string(r.mean) + ".\n";
+        }
+    }
+
+    void print_bit_positions() {
+        std::cout << "\n";
+        for (auto r = bitPositions.rbegin(); r != bitPositions.rend(); ++r) {
+            std::cout << "Bit " + std::to_string(r->position) + " is one in " + std::to_string(r->ones) + " of samples, chi square " + std::to_string(r->chisquare) + " (p-value " + std::to_string(r->p_value) + "),\n";
+            std::cout << "lag-1 correlation " + std::to_string(r->correlation) + ".\n";
+        }
+    }
+
+    void print_knuth() {
+        const KnuthResult &r = knuth;
+        std::cout << "\nPoker test of " + std::to_string(r.hands) + " hands of five " + std::to_string(r.symbolBits) + "-bit symbols has chi square " + std::to_string(r.pokerChisquare) + ", p-value " + std::to_string(r.pokerP) + ".\n";
+        std::cout << "Gap test of " + std::to_string(r.gaps) + " gaps has chi square " + std::to_string(r.gapChisquare) + ", p-value " + std::to_string(r.gapP) + ".\n";
+        if (r.coupons == 0) {
+            std::cout << "Coupon collector test is undefined (no segment followed from the start of the stream).\n";
+            return;
+        }
+        std::cout << "Coupon collector test of " + std::to_string(r.coupons) + " segments has chi square " + std::to_string(r.couponChisquare) + ", p-value " + std::to_string(r.couponP) + ".\n";
+    }
+
+    void print_birthday() {
+        const BirthdayResult &r = birthday;
+        if (r.trials == 0) {
+            std::cout << "\nBirthday spacings test is undefined (less than one trial of " + std::to_string(r.birthdays * r.sampleBits / 8) + " bytes in memory).\n";
+            return;
+        }
+        std::cout << "\nBirthday spacings test found " + std::to_string(r.collisions) + " repeated spacings in " + std::to_string(r.trials) + " trials of " + std::to_string(r.birthdays) + " " + std::to_string(r.sampleBits) + "-bit birthdays\n";
+        std::cout << "(" + std::to_string(r.lambda * r.trials) + " expected), p-value " + std::to_string(r.p_value) + ".\n";
+    }
+
+    void print_patterns() {
+        const PatternResult &r = patterns.back();
+        std::cout << "\nSerial test of " + std::to_string(r.length) + "-bit patterns has p-values " + std::to_string(r.serialP) + " and " + std::to_string(r.serialP2) + ",\n";
+        std::cout << "approximate entropy is " + std::to_string(r.approximateEntropy) + " (" + std::to_string(M_LN2) + " = random), p-value " + std::to_string(r.approximateEntropyP) + ".\n";
+    }
+
+    void print_universal() {
+        std::cout << "\nMaurer's universal test over " + std::to_string(universal.blocks) + " blocks of " + std::to_string(universal.blockBits) + " bits is " + std::to_string(universal.statistic) + " (" + std::to_string(universal.expected) + " = random),\n";
+        std::cout << "p-value " + std::to_string(universal.p_value) + ".\n";
+    }
+
+    void print_linear_complexity() {
+        const LinearComplexityResult &r = linearComplexity;
+        std::cout << "\nLinear complexity test over " + std::to_string(r.blocks) + " blocks of " + std::to_string(r.blockBits) + " bits has chi square " + std::to_string(r.chisquare) + ", p-value " + std::to_string(r.p_value) + ",\n";
+        std::cout << "shortest LFSR " + std::to_string(r.minimum) + " bits (random = about " + std::to_string(r.blockBits / 2) + ").\n";
+    }
+
+    void print_matrix_rank() {
+        std::cout << "\nBinary matrix rank test chi square is " + std::to_string(matrixRank.chisquare32) + ", p-value " + std::to_string(matrixRank.p32) + " for " + std::to_string(matrixRank.matrices32) + " 32 x 32 matrices,\n";
+        std::cout << "and " + std::to_string(matrixRank.chisquare64) + ", p-value " + std::to_string(matrixRank.p64) + " for " + std::to_string(matrixRank.matrices64) + " 64 x 64 matrices.\n";
+    }
+
+    void print_spectral() {
+        if (spectral.blocks == 0) {
+            std::cout << "\nDFT spectral test is undefined (less than one block of " + std::to_string(spectral.blockBits) + " bits in memory).\n";
+            return;
+        }
+        std::cout << "\nDFT spectral test over " + std::to_string(spectral.blocks) + " blocks of " + std::to_string(spectral.blockBits) + " bits has p-value " + std::to_string(spectral.p_value) + ",\n";
+        std::cout << std::to_string(spectral.passRate * 100) + " percent of the blocks pass at " + std::to_string(SPECTRAL_ALPHA) + " and their p-values are uniform with p-value " + std::to_string(spectral.uniformity) + ".\n";
+    }
+
+    void print_autocorrelation() {
+        if (autocorrelation.empty()) {
+            std::cout << "\nAutocorrelation is undefined (no byte data in memory).\n";
+            return;
+        }
+        std::cout << "\nAutocorrelation over byte lags 1 to " + std::to_string(autocorrelation.size()) + " is strongest at";
+        std::vector<size_t> strongest = strongest_lags(AUTOCORRELATION_STRONGEST);
+        for (size_t i = 0; i < strongest.size(); ++i) {
+            std::cout << (i == 0 ? " " : ", ") << "lag " + std::to_string(strongest[i]) + " (" + std::to_string(autocorrelation[strongest[i] - 1]) + ")";
+        }
+        std::cout << "\n(random = 0.0, standard deviation " + std::to_string(1.0 / std::sqrt(double(data.size()))) + ").\n";
+    }
+
+    void print_bit_battery() {
+        const BitBatteryResult &r = bitBattery;
+        std::cout << "\nBit tests over " + std::to_string(r.bits) + " bits (p-values, random = uniform on 0..1):\n";
+        std::cout << "Frequency test p-value is " + std::to_string(r.frequency) + ".\n";
+        std::cout << "Block frequency test chi square is " + std::to_string(r.blockFrequencyChisquare) + ", p-value " + std::to_string(r.blockFrequency) + ".\n";
+        std::cout << "Runs test p-value is " + std::to_string(r.runs) + ".\n";
+        std::cout << "Longest run of ones test chi square is " + std::to_string(r.longestRunChisquare) + ", p-value " + std::to_string(r.longestRun) + ".\n";
+        std::cout << "Cumulative sums test p-values are " + std::to_string(r.cumulativeSumsForward) + " (forward) and " + std::to_string(r.cumulativeSumsReverse) + " (reverse).\n";
+    }
+
+    void print_table() {
+        if constexpr (symbol_mode()) {
+            // Symbols wider than a byte are listed only when they occur
+            uint64_t total = symbol_count();
+            for_each_symbol_count([&](uint32_t value, uint64_t count) {
+                if (count > 0 || Policy::symbolBits < 8) {
+                    std::cout << "Value: " << value << " Occurrences: " << count << " Fraction: " << count / static_cast<double>(total) << "\n";
+                }
+            });
+            std::cout << "\nTotal: " << total << " 1.0\n\n";
+            return;
+        }
+        build_histogram();
+        if (bit_mode()) {
+            std::array<uint64_t, 2> bitOccurrences = bit_counts();
+
+            // Print bit occurrences and fraction
+            for (int bitValue = 0; bitValue <= 1; ++bitValue) {
+                double fraction = bitOccurrences[bitValue] / static_cast<double>(byte_count() * 8);
+                std::cout << "Value: " << bitValue << " Occurrences: " << bitOccurrences[bitValue] << " Fraction: " << fraction << "\n";
+            }
+        } else {
+            // Print byte occurrences and fraction
+            for (int byteValue = 0; byteValue < BYTE_VAL_COUNT; ++byteValue) {
+                double fraction = histogram[byteValue] / static_cast<double>(byte_count());
+                std::cout << "Value: " << byteValue << " Char: " << char(isprint(byteValue) ?  byteValue : ' ') << " Occurrences: " << histogram[byteValue] << " Fraction: " << fraction << "\n";
+            }
+        }
+
+        std::cout << "\nTotal: " << byte_count() << " 1.0\n\n";
+    }
+
+    void print_result_terse() {
+        bool bits = bit_mode();
+        std::string samp = symbol_mode() ? "symbol" : bits ? "bit" : "byte";
+        long long totalc = symbol_mode() ? symbol_count() : bits ? (byte_count()*8) : (byte_count());
+        std::string header = "0,File-" + samp + "s";
+        std::ostringstream values;
+        values << "1," << totalc;
+        if (selected(TEST_ENTROPY)) {
+            header += ",Entropy";
+            values << "," << entropy;
+        }
+        if (selected(TEST_CHISQUARE)) {
+            header += ",Chi-square";
+            values << "," << chisquare;
+        }
+        if (selected(TEST_MEAN)) {
+            header += ",Mean";
+            values << "," << mean;
+        }
+        if (selected(TEST_PI)) {
+            header += ",Monte-Carlo-Pi";
+            values << "," << pi_estimate;
+        }
+        if (selected(TEST_SERIAL_CORRELATION)) {
+            header += ",Serial-Correlation";
+            values << "," << serial_correlation;
+        }
+        std::cout << header << "\n" << values.str() << "\n";
+    }
+
+    void print_lz_terse() {
+        std::cout << "4,File-bytes,LZ-size,LZ-compression\n5,";
+        std::cout << byte_count() << "," << lz_size << "," << lz_compression << "\n";
+    }
+
+    void print_bit_battery_terse() {
+        std::cout << "6,File-bits,Frequency,Block-frequency,Runs,Longest-run,Cumulative-sums-forward,Cumulative-sums-reverse\n7,";
+        std::cout << bitBattery.bits << "," << bitBattery.frequency << "," << bitBattery.blockFrequency << "," << bitBattery.runs << "," << bitBattery.longestRun << "," << bitBattery.cumulativeSumsForward << "," << bitBattery.cumulativeSumsReverse << "\n";
+    }
+
+    void print_transforms_terse() {
+        std::cout << "30,Transform,Lag,Samples,Entropy,Chi-square,Chi-square-p,Mean\n";
+        for (const TransformResult &r : transforms) {
+            std::cout << "31," << r.name << "," << r.lag << "," << r.samples << "," << r.entropy << "," << r.chisquare << "," << r.p_value << "," << r.mean << "\n";
+        }
+    }
+
+    void print_float_fields_terse() {
+        const FloatFieldResult &r = floatFields;
+        std::cout << "28,Field,Entropy\n";
+        std::cout << "29,sign," << r.signEntropy << "\n29,exponent," << r.exponentEntropy << "\n";
+        for (size_t k = 0; k < r.mantissaEntropy.size(); ++k) {
+            std::cout << "29,mantissa-" << k << "," << r.mantissaEntropy[k] << "\n";
+        }
+        std::cout << "29,xor," << r.xorEntropy << "\n";
+        for (size_t k = 0; k < r.xorByteEntropy.size(); ++k) {
+            std::cout << "29,xor-" << k << "," << r.xorByteEntropy[k] << "\n";
+        }
+    }
+
+    void print_columns_terse() {
+        std::cout << "26,Column,Samples,Entropy,Chi-square,Chi-square-p,Mean\n";
+        for (const ColumnResult &r : columns) {
+            std::cout << "27," << r.column << "," << r.samples << "," << r.entropy << "," << r.chisquare << "," << r.p_value << "," << r.mean << "\n";
+        }
+    }
+
+    void print_bit_positions_terse() {
+        std::cout << "24,Bit,Ones-fraction,Chi-square,Bias-p,Lag1-correlation\n";
+        for (const BitPositionResult &r : bitPositions) {
+            std::cout << "25," << r.position << "," << r.ones << "," << r.chisquare << "," << r.p_value << "," << r.correlation << "\n";
+        }
+    }
+
+    void print_knuth_terse() {
+        std::cout << "22,Symbol-bits,Hands,Poker-chi-square,Poker-p,Gaps,Gap-chi-square,Gap-p,Coupons,Coupon-chi-square,Coupon-p\n23,";
+        std::cout << knuth.symbolBits << "," << knuth.hands << "," << knuth.pokerChisquare << "," << knuth.pokerP << "," << knuth.gaps << "," << knuth.gapChisquare << "," << knuth.gapP << "," << knuth.coupons << "," << knuth.couponChisquare << "," << knuth.couponP << "\n";
+    }
+
+    void print_birthday_terse() {
+        std::cout << "20,Sample-bits,Trials,Birthdays,Lambda,Collisions,Birthday-p\n21,";
+        std::cout << birthday.sampleBits << "," << birthday.trials << "," << birthday.birthdays << "," << birthday.lambda << "," << birthday.collisions << "," << birthday.p_value << "\n";
+    }
+
+    void print_patterns_terse() {
+        std::cout << "18,Pattern-bits,Serial-delta,Serial-p,Serial-delta2,Serial-p2,Approximate-entropy,Approximate-entropy-p\n";
+        for (const PatternResult &r : patterns) {
+            std::cout << "19," << r.length << "," << r.serialDelta << "," << r.serialP << "," << r.serialDelta2 << "," << r.serialP2 << "," << r.approximateEntropy << "," << r.approximateEntropyP << "\n";
+        }
+    }
+
+    void print_universal_terse() {
+        std::cout << "16,Block-bits,Blocks,Universal-statistic,Universal-expected,Universal-p\n17,";
+        std::cout << universal.blockBits << "," << universal.blocks << "," << universal.statistic << "," << universal.expected << "," << universal.p_value << "\n";
+    }
+
+    void print_linear_complexity_terse() {
+        std::cout << "14,Blocks,Block-bits,Minimum-complexity,Complexity-chi-square,Complexity-p\n15,";
+        std::cout << linearComplexity.blocks << "," << linearComplexity.blockBits << "," << linearComplexity.minimum << "," << linearComplexity.chisquare << "," << linearComplexity.p_value << "\n";
+    }
+
+    void print_matrix_rank_terse() {
+        std::cout << "12,Matrices-32,Rank-chi-square-32,Rank-p-32,Matrices-64,Rank-chi-square-64,Rank-p-64\n13,";
+        std::cout << matrixRank.matrices32 << "," << matrixRank.chisquare32 << "," << matrixRank.p32 << "," << matrixRank.matrices64 << "," << matrixRank.chisquare64 << "," << matrixRank.p64 << "\n";
+    }
+
+    void print_spectral_terse() {
+        std::cout << "10,Blocks,Block-bits,Spectral-statistic,Spectral-p,Pass-rate,Uniformity-p\n11,";
+        std::cout << spectral.blocks << "," << spectral.blockBits << "," << spectral.statistic << "," << spectral.p_value << "," << spectral.passRate << "," << spectral.uniformity << "\n";
+    }
+
+    void print_autocorrelation_terse() {
+        std::cout << "8,Lag,Autocorrelation\n";
+        for (size_t lag = 1; lag <= autocorrelation.size(); ++lag) {
+            std::cout << "9," << lag << "," << autocorrelation[lag - 1] << "\n";
+        }
+    }
+
+    void print_table_terse() {
+        build_histogram();
+        std::cout << "2,Value,Occurrences,Fraction\n";
+        if constexpr (symbol_mode()) {
+            uint64_t total = symbol_count();
+            for_each_symbol_count([&](uint32_t value, uint64_t count) {
+                if (count > 0 || Policy::symbolBits < 8) {
+                    std::cout << "3," << value << "," << count << "," << (count / static_cast<double>(total)) << "\n";
+                }
+            });
+            return;
+        }
+        if (bit_mode()) {
+            std::array<uint64_t, 2> bitOccurrences = bit_counts();
+            for(int i=0; i<2; ++i) {
+                std::cout << "3," << i << "," << bitOccurrences[i] << "," << (bitOccurrences[i] / static_cast<double>(byte_count()*8)) << "\n";
+            }
+        } else {
+            for(int i=0; i<BYTE_VAL_COUNT; ++i) {
+                std::cout << "3," << i << "," << histogram[i] << "," << (histogram[i] / static_cast<double>(byte_count())) << "\n";
+            }
+        }
+    }
+
+    // Numerical approximation of the CDF for a standard normal distribution
+    double norm_cdf(double x) {
+        return 0.5 * erfc(-x * M_SQRT1_2);
+    }
+
+    // Byte value occurrences, shared by entropy, chi-square, mean and the tables
+    void build_histogram() {
+        if (histogramReady) {
+            return;
+        }
+        if (loadedState) {
+            histogram = loadedState->get_histogram();
+            histogramReady = true;
+            return;
+        }
+
+        // Four interleaved tables keep runs of equal bytes from serializing on one counter
+        std::array<uint64_t, 4 * BYTE_VAL_COUNT> partial{};
+        size_t i = 0;
+        for (; i + 4 <= data.size(); i += 4) {
+            partial[data[i]]++;
+            partial[BYTE_VAL_COUNT + data[i+1]]++;
+            partial[2 * BYTE_VAL_COUNT + data[i+2]]++;
+            partial[3 * BYTE_VAL_COUNT + data[i+3]]++;
+        }
+        for (; i < data.size(); ++i) {
+            partial[data[i]]++;
+        }
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            histogram[value] = partial[value] + partial[BYTE_VAL_COUNT + value] + partial[2 * BYTE_VAL_COUNT + value] + partial[3 * BYTE_VAL_COUNT + value];
+        }
+
+        // Folding case is a merge of bins, no pass over the data is needed
+        if (foldCaseMode) {
+            const auto &table = fold_table();
+            for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+                if (table[value] != value) {
+                    histogram[table[value]] += histogram[value];
+                    histogram[value] = 0;
+                }
+            }
+        }
+        histogramReady = true;
+    }
+
+    // Occurrences of 0 and 1 bits, derived from the byte histogram
+    std::array<uint64_t, 2> bit_counts() {
+        uint64_t ones = 0;
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            ones += histogram[value] * std::popcount(unsigned(value));
+        }
+        return {8 * byte_count() - ones, ones};
+    }
+
+    // Calls f with every whole symbol of the data in stream order
+    template <typename F>
+    void for_each_symbol(F f) const {
+        constexpr uint32_t width = Policy::symbolBits;
+        constexpr uint64_t mask = (uint64_t(1) << width) - 1;
+        constexpr bool big = Policy::symbolOrder == Endian::Big;
+        with_byte_map([&](auto map) {
+            if constexpr (width % 8 == 0) {
+                constexpr size_t size = width / 8;
+                for (size_t i = 0; i + size <= data.size(); i += size) {
+                    uint32_t symbol = 0;
+                    for (size_t k = 0; k < size; ++k) {
+                        symbol = (symbol << 8) | map(data[i + (big ? k : size - 1 - k)]);
+                    }
+                    f(symbol);
+                }
+            } else {
+                // Packed symbols, extracted from a bit register refilled a byte at a time
+                uint64_t held = 0;
+                uint32_t count = 0;
+                for (unsigned char byte : data) {
+                    if constexpr (big) {
+                        held = (held << 8) | map(byte);
+                        count += 8;
+                        while (count >= width) {
+                            count -= width;
+                            f(uint32_t((held >> count) & mask));
+                        }
+                    } else {
+                        held |= uint64_t(map(byte)) << count;
+                        count += 8;
+                        while (count >= width) {
+                            f(uint32_t(held & mask));
+                            held >>= width;
+                            count -= width;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    // Symbol counts: dense up to SYMBOL_DENSE_BITS bits, wider symbols are radix sorted and
+    // counted in runs. Symbols that divide a byte follow from the byte histogram.
+    void build_symbol_histogram() {
+        if (symbolHistogramReady) {
+            return;
+        }
+        constexpr uint32_t width = Policy::symbolBits;
+        constexpr uint32_t mask = uint32_t((uint64_t(1) << width) - 1);
+        if constexpr (width <= SYMBOL_DENSE_BITS) {
+            symbolHistogram.assign(size_t(1) << width, 0);
+            if constexpr (8 % width == 0) {
+                build_histogram();
+                for (uint32_t value = 0; value < BYTE_VAL_COUNT; ++value) {
+                    for (uint32_t shift = 0; shift < 8; shift += width) {
+                        symbolHistogram[(value >> shift) & mask] += histogram[value];
+                    }
+                }
+            } else {
+                for_each_symbol([&](uint32_t symbol) { symbolHistogram[symbol]++; });
+            }
+        } else {
+            std::vector<uint64_t> values;
+            values.reserve(8 * data.size() / width);
+            for_each_symbol([&](uint32_t symbol) { values.push_back(symbol); });
+            std::vector<uint64_t> scratch(values.size());
+            radix_sort(values, scratch, width, std::max(1u, std::thread::hardware_concurrency()));
+            symbolRuns.clear();
+            for (size_t i = 0; i < values.size();) {
+                size_t end = i + 1;
+                while (end < values.size() && values[end] == values[i]) {
+                    end++;
+                }
+                symbolRuns.push_back({uint32_t(values[i]), end - i});
+                i = end;
+            }
+        }
+        symbolHistogramReady = true;
+    }
+
+    // Calls f(value, count) for the symbol values, at least all that occur
+    template <typename F>
+    void for_each_symbol_count(F f) const {
+        if constexpr (Policy::symbolBits <= SYMBOL_DENSE_BITS) {
+            for (size_t value = 0; value < symbolHistogram.size(); ++value) {
+                f(uint32_t(value), symbolHistogram[value]);
+            }
+        } else {
+            for (const auto &[value, count] : symbolRuns) {
+                f(value, count);
+            }
+        }
+    }
+
+    uint64_t symbol_count() {
+        build_symbol_histogram();
+        uint64_t total = 0;
+        for_each_symbol_count([&](uint32_t, uint64_t count) { total += count; });
+        return total;
+    }
+
+    void calculate_symbol_entropy() {
+        build_symbol_histogram();
+        // Four partial sums of c log2 c keep the additions independent
+        std::array<double, 4> sums{};
+        uint64_t total = 0;
+        size_t lane = 0;
+        for_each_symbol_count([&](uint32_t, uint64_t count) {
+            total += count;
+            sums[lane++ & 3] += count > 0 ? double(count) * std::log2(double(count)) : 0.0;
+        });
+        double n = double(total);
+        entropy = total > 0 ? std::log2(n) - (sums[0] + sums[1] + sums[2] + sums[3]) / n : 0.0;
+        compression = 100.0 * (1.0 - entropy / Policy::symbolBits);
+    }
+
+    void calculate_symbol_chisquare() {
+        build_symbol_histogram();
+        // Sum of (c - e)^2 / e over every value, those that do not occur included
+        double squares = 0.0;
+        uint64_t total = 0;
+        for_each_symbol_count([&](uint32_t, uint64_t count) {
+            total += count;
+            squares += double(count) * double(count);
+        });
+        double values = std::ldexp(1.0, int(Policy::symbolBits));
+        double expected = double(total) / values;
+        chisquare = squares / expected - double(total);
+        p_value = chisquare_p(chisquare, values - 1.0);
+    }
+
+    void calculate_symbol_mean() {
+        build_symbol_histogram();
+        double sum = 0.0;
+        uint64_t total = 0;
+        for_each_symbol_count([&](uint32_t value, uint64_t count) {
+            total += count;
+            sum += double(value) * double(count);
+        });
+        mean = sum / double(total);
+    }
+
+    void calculate_symbol_serial_correlation() {
+        build_symbol_histogram();
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        uint64_t total = 0;
+        for_each_symbol_count([&](uint32_t value, uint64_t count) {
+            total += count;
+            sum += double(value) * double(count);
+            sumSquares += double(value) * double(value) * double(count);
+        });
+
+        // Products of symbols up to 16 bits are summed exactly over blocks of 2^16
+        double sumXY = 0.0;
+        uint64_t blockSum = 0;
+        uint32_t blockLength = 0;
+        uint32_t first = 0;
+        uint32_t previous = 0;
+        bool started = false;
+        for_each_symbol([&](uint32_t symbol) {
+            if (!started) {
+                first = symbol;
+                started = true;
+            } else if constexpr (Policy::symbolBits <= SYMBOL_DENSE_BITS) {
+                blockSum += uint64_t(previous) * symbol;
+                if (++blockLength == (uint32_t(1) << 16)) {
+                    sumXY += double(blockSum);
+                    blockSum = 0;
+                    blockLength = 0;
+                }
+            } else {
+                sumXY += double(previous) * double(symbol);
+            }
+            previous = symbol;
+        });
+        sumXY += double(blockSum);
+        if (!started || total == 0) {
+            serial_correlation = std::nan("");
+            return;
+        }
+
+        double last = previous;
+        double sumX = sum - last;
+        double sumY = sum - first;
+        double sumX2 = sumSquares - last * last;
+        double sumY2 = sumSquares - double(first) * first;
+        double n = double(total) - 1;
+        serial_correlation = (n * sumXY - sumX * sumY) / std::sqrt((n * sumX2 - sumX * sumX) * (n * sumY2 - sumY * sumY));
+    }
+
+    void calculate_entropy() {
+        if constexpr (symbol_mode()) {
+            calculate_symbol_entropy();
+            return;
+        }
+        build_histogram();
+        if (bit_mode()) {
+            std::array<uint64_t, 2> frequencies = bit_counts();  // Frequencies for 2 possible bit values: 0 and 1
+
+            entropy = 0.0;
+            double totalBits = 8.0 * byte_count();
+            for (auto &count : frequencies) {
+                double frequency = count / totalBits;
+                if (frequency > 0) {
+                    entropy -= frequency * (std::log2(frequency));
+                }
+            }
+
+            // Calculate the optimal compression percentage
+            double max_entropy = 1.0;  // Max entropy in bits per bit
+            compression = 100.0 * (1.0 - entropy / max_entropy);
+        } else {
+            entropy = 0.0;
+            for (auto &count : histogram) {
+                double frequency = count / static_cast<double>(byte_count());
+                if (frequency > 0) {
+                    entropy -= frequency * (std::log2(frequency));
+                }
+            }
+
+            // Calculate the optimal compression percentage
+            double max_entropy = 8.0;  // Max entropy in bits per byte
+            compression = 100.0 * (1.0 - entropy / max_entropy);
+        }
+    }
+
+
+    void calculate_chisquare() {
+        if constexpr (symbol_mode()) {
+            calculate_symbol_chisquare();
+            return;
+        }
+        build_histogram();
+        if (bit_mode()) {
+            double expected = 8.0 * byte_count() / 2.0;  // For bits, only two possibilities 0 and 1
+            std::array<uint64_t, 2> observed = bit_counts();  // For bits
+
+            chisquare = 0.0;
+            for (int i = 0; i < 2; ++i) {
+                double diff = observed[i] - expected;
+                chisquare += diff * diff / expected;
+            }
+
+            int degree_of_freedom = 1;  // For bits
+
+            // Transform Chi-square to z-value
+            double z = std::sqrt(chisquare - degree_of_freedom);
+
+            // Calculate p-value from standard normal distribution
+            p_value = 1 - norm_cdf(z);
+        } else {
+            double expected = byte_count() / static_cast<double>(BYTE_VAL_COUNT);
+
+            chisquare = 0.0;
+            for (int i = 0; i < BYTE_VAL_COUNT; ++i) {
+                double diff = histogram[i] - expected;
+                chisquare += diff * diff / expected;
+            }
+
+            int degree_of_freedom = BYTE_VAL_COUNT - 1;
+
+            // Transform Chi-square to z-value
+            double z = std::sqrt(chisquare - degree_of_freedom);
+
+            // Calculate p-value from standard normal distribution
+            p_value = 1 - norm_cdf(z);
+        }
+    }
+
+
+    void calculate_mean() {
+        if constexpr (symbol_mode()) {
+            calculate_symbol_mean();
+            return;
+        }
+        build_histogram();
+        if (bit_mode()) {
+            mean = double(bit_counts()[1]) / (8.0 * byte_count());
+            return;
+        }
+        double sum = 0.0;
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            sum += double(value) * histogram[value];
+        }
+        mean = sum / byte_count();
+    }
+
+    // Each point is 48 consecutive bits of the stream, most significant first, as two 24-bit
+    // coordinates. Assembled from bits or from bytes these are the same points, so bit mode
+    // needs no pass of its own.
+    void calculate_pi() {
+        unsigned long long radiusSquared = static_cast<unsigned long long>(1) << 48;
+
+        unsigned long hits = 0;
+        unsigned long total = 0;
+
+        if (loadedState) {
+            pi_estimate = 4.0 * loadedState->get_pi_hits() / loadedState->get_pi_total();
+            return;
+        }
+        with_byte_map([&](auto map) {
+            for (size_t i = 0; i + 5 < data.size(); i += 6) {
+                unsigned long long x = static_cast<unsigned long long>(map(data[i])) << 16 | static_cast<unsigned long long>(map(data[i+1])) << 8 | map(data[i+2]);
+                unsigned long long y = static_cast<unsigned long long>(map(data[i+3])) << 16 | static_cast<unsigned long long>(map(data[i+4])) << 8 | map(data[i+5]);
+
+                unsigned long long distanceSquared = x * x + y * y;
+
+                if (distanceSquared < radiusSquared) {
+                    hits++;
+                }
+                total++;
+            }
+        });
+
+        pi_estimate = 4.0 * hits / total;
+    }
+
+    // Correlation of each bit with the next one. Over bits the sum of products is the number
+    // of adjacent 11 pairs, which follows from the ones and the adjacent bits that differ,
+    // counted 64 at a time as the ones of w ^ (w >> 1) with the preceding bit shifted in.
+    void calculate_bit_serial_correlation() {
+        uint64_t changes = loadedState ? loadedState->get_bit_changes() : with_byte_map([&](auto map) {
+            uint64_t count = 0;
+            uint64_t previous = data.empty() ? 0 : map(data[0]) >> 7;  // The first bit has no predecessor
+            size_t i = 0;
+            for (; i + 8 <= data.size(); i += 8) {
+                uint64_t word = 0;
+                for (int k = 0; k < 8; ++k) {
+                    word = (word << 8) | map(data[i + k]);
+                }
+                count += std::popcount(word ^ ((word >> 1) | (previous << 63)));
+                previous = word & 1;
+            }
+            for (; i < data.size(); ++i) {
+                unsigned bits = unsigned(previous) << 8 | map(data[i]);
+                count += std::popcount((bits ^ (bits >> 1)) & 0xFFu);
+                previous = bits & 1;
+            }
+            return count;
+        });
+        if (byte_count() == 0) {
+            serial_correlation = std::nan("");
+            return;
+        }
+
+        unsigned long long first = loadedState ? loadedState->get_first() : with_byte_map([&](auto map) { return map(data.front()); });
+        unsigned long long last = loadedState ? loadedState->get_last() : with_byte_map([&](auto map) { return map(data.back()); });
+        double ones = double(bit_counts()[1]);
+        double sumX = ones - double(last & 1);
+        double sumY = ones - double(first >> 7);
+        double sumXY = (sumX + sumY - double(changes)) / 2.0;
+
+        double n = 8.0 * byte_count() - 1;
+        serial_correlation = (n * sumXY - sumX * sumY) / std::sqrt((n * sumX - sumX * sumX) * (n * sumY - sumY * sumY));
+    }
+
+    void calculate_serial_correlation() {
+        if constexpr (symbol_mode()) {
+            calculate_symbol_serial_correlation();
+            return;
+        }
+        build_histogram();
+        if (bit_mode()) {
+            calculate_bit_serial_correlation();
+            return;
+        }
+
+        // Only the sum of products needs a pass, the other sums follow from the histogram
+        unsigned long long sumXY = loadedState ? loadedState->get_product_sum() : with_byte_map([&](auto map) {
+            unsigned long long sum = 0;
+            for (size_t i = 1; i < data.size(); ++i) {
+                sum += static_cast<unsigned long long>(map(data[i - 1])) * map(data[i]);
+            }
+            return sum;
+        });
+
+        unsigned long long sum = 0;
+        unsigned long long sumSquares = 0;
+        for (unsigned long long value = 0; value < BYTE_VAL_COUNT; ++value) {
+            sum += value * histogram[value];
+            sumSquares += value * value * histogram[value];
+        }
+        unsigned long long first = loadedState ? loadedState->get_first() : data.empty() ? 0 : with_byte_map([&](auto map) { return map(data.front()); });
+        unsigned long long last = loadedState ? loadedState->get_last() : data.empty() ? 0 : with_byte_map([&](auto map) { return map(data.back()); });
+
+        // Products of the sums overflow 64 bits for inputs of a few hundred megabytes
+        double sumX = sum - last;
+        double sumY = sum - first;
+        double sumX2 = sumSquares - last * last;
+        double sumY2 = sumSquares - first * first;
+
+        double n = byte_count() - 1;
+        serial_correlation = (n * sumXY - sumX * sumY) / std::sqrt((n * sumX2 - sumX * sumX) * (n * sumY2 - sumY * sumY));
+    }
+
+    // SP 800-22 DFT spectral test on every whole block of spectralBlockBits bits, most
+    // significant bit first. Two blocks share one complex FFT as its real and imaginary
+    // parts, and the pairs of blocks run in parallel.
+    void calculate_spectral() {
+        const double nan = std::nan("");
+        size_t blockBytes = spectralBlockBits / 8;
+        size_t blocks = data.size() / blockBytes;
+        spectral = {blocks, spectralBlockBits, nan, nan, nan, nan};
+        if (blocks == 0) {
+            return;
+        }
+
+        Fft fft(spectralBlockBits);
+        double n = spectralBlockBits;
+        double threshold = std::sqrt(std::log(1.0 / (1.0 - SPECTRAL_PEAK_FRACTION)) * n);
+        double expected = SPECTRAL_PEAK_FRACTION * n / 2.0;
+        double deviation = std::sqrt(n * SPECTRAL_PEAK_FRACTION * (1.0 - SPECTRAL_PEAK_FRACTION) / 4.0);
+        double limit = 4.0 * threshold * threshold;
+
+        // Signs of the eight bits of a byte, most significant first
+        static const std::array<std::array<double, 8>, BYTE_VAL_COUNT> signs = [] {
+            std::array<std::array<double, 8>, BYTE_VAL_COUNT> table{};
+            for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+                for (int bit = 0; bit < 8; ++bit) {
+                    table[value][bit] = ((value << bit) & 0x80) ? 1.0 : -1.0;
+                }
+            }
+            return table;
+        }();
+
+        size_t pairs = (blocks + 1) / 2;
+        size_t parts = std::min<size_t>(pairs, std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<double> excess(parts, 0.0);
+        std::vector<double> blockP(blocks);
+        parallel_for(parts, [&](size_t part) {
+            std::vector<std::complex<double>> packed(spectralBlockBits);
+            for (size_t pair = part; pair < pairs; pair += parts) {
+                size_t first = 2 * pair;
+                bool second = first + 1 < blocks;
+                with_byte_map([&](auto map) {
+                    const unsigned char *re = data.data() + first * blockBytes;
+                    const unsigned char *im = re + blockBytes;
+                    for (size_t i = 0; i < blockBytes; ++i) {
+                        const std::array<double, 8> &a = signs[map(re[i])];
+                        const std::array<double, 8> &b = signs[second ? map(im[i]) : 0];
+                        for (int bit = 0; bit < 8; ++bit) {
+                            packed[8 * i + bit] = {a[bit], b[bit]};
+                        }
+                    }
+                });
+                fft.transform(packed.data());
+                // |2 A_k| and |2 B_k| of the two real blocks from Z_k and conj(Z_(n-k)), squared
+                size_t below[2] = {0, 0};
+                for (size_t k = 0; k < spectralBlockBits / 2; ++k) {
+                    const std::complex<double> &z = packed[k];
+                    const std::complex<double> &mirror = packed[(spectralBlockBits - k) & (spectralBlockBits - 1)];
+                    double sumRe = z.real() + mirror.real(), sumIm = z.imag() - mirror.imag();
+                    double differenceRe = z.real() - mirror.real(), differenceIm = z.imag() + mirror.imag();
+                    below[0] += sumRe * sumRe + sumIm * sumIm < limit;
+                    below[1] += differenceRe * differenceRe + differenceIm * differenceIm < limit;
+                }
+                for (size_t b = 0; b < (second ? 2u : 1u); ++b) {
+                    double d = (double(below[b]) - expected) / deviation;
+                    blockP[first + b] = std::erfc(std::fabs(d) * M_SQRT1_2);
+                    excess[part] += double(below[b]) - expected;
+                }
+            }
+        });
+
+        double total = std::accumulate(excess.begin(), excess.end(), 0.0);
+        spectral.statistic = total / (deviation * std::sqrt(double(blocks)));
+        spectral.p_value = std::erfc(std::fabs(spectral.statistic) * M_SQRT1_2);
+        std::array<double, SPECTRAL_P_BINS> bins{};
+        size_t passed = 0;
+        for (double p : blockP) {
+            passed += p >= SPECTRAL_ALPHA;
+            bins[std::min(SPECTRAL_P_BINS - 1, int(p * SPECTRAL_P_BINS))]++;
+        }
+        spectral.passRate = double(passed) / blocks;
+        double chisquare = 0.0;
+        for (double count : bins) {
+            double binExpected = double(blocks) / SPECTRAL_P_BINS;
+            chisquare += (count - binExpected) * (count - binExpected) / binExpected;
+        }
+        spectral.uniformity = chisquare_p(chisquare, SPECTRAL_P_BINS - 1);
+    }
+
+    // Birthday spacings test on trials of n birthdays in a year of 2^sampleBits days, with n
+    // chosen so that lambda = n^3 / (4 * 2^sampleBits) is 4 for 32-bit and 1 for 64-bit
+    // samples. Trials run concurrently; with fewer trials than cores each sort is split.
+    void calculate_birthday() {
+        uint32_t sampleBytes = birthdaySampleBits / 8;
+        uint64_t birthdays = birthdaySampleBits == 64 ? (uint64_t(1) << 22) : (uint64_t(1) << 12);
+        double lambda = std::pow(double(birthdays), 3.0) / std::ldexp(4.0, int(birthdaySampleBits));
+        size_t trials = data.size() / (birthdays * sampleBytes);
+        birthday = {birthdaySampleBits, trials, birthdays, lambda, 0, std::nan("")};
+        if (trials == 0) {
+            return;
+        }
+
+        size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        size_t parts = std::max<size_t>(1, workers / trials);
+        std::vector<uint64_t> collisions(trials, 0);
+        parallel_for(trials, [&](size_t trial) {
+            std::vector<uint64_t> days(birthdays);
+            std::vector<uint64_t> scratch(birthdays);
+            const unsigned char *bytes = data.data() + trial * birthdays * sampleBytes;
+            with_byte_map([&](auto map) {
+                for (uint64_t i = 0; i < birthdays; ++i) {
+                    uint64_t day = 0;
+                    for (uint32_t k = 0; k < sampleBytes; ++k) {
+                        day = (day << 8) | map(bytes[i * sampleBytes + k]);
+                    }
+                    days[i] = day;
+                }
+            });
+            radix_sort(days, scratch, birthdaySampleBits, parts);
+            // The n - 1 spacings between consecutive birthdays, sorted in turn
+            std::adjacent_difference(days.begin(), days.end(), days.begin());
+            days.erase(days.begin());
+            scratch.resize(days.size());
+            radix_sort(days, scratch, birthdaySampleBits, parts);
+            for (size_t i = 1; i < days.size(); ++i) {
+                collisions[trial] += days[i] == days[i - 1];
+            }
+        });
+
+        uint64_t total = std::accumulate(collisions.begin(), collisions.end(), uint64_t(0));
+        double mean = lambda * trials;
+        // P(X <= total) = Q(total + 1, mean) and P(X >= total) = 1 - Q(total, mean)
+        double lower = igamc(double(total) + 1.0, mean);
+        double upper = total == 0 ? 1.0 : 1.0 - igamc(double(total), mean);
+        birthday.collisions = total;
+        birthday.p_value = std::min(1.0, 2.0 * std::min(lower, upper));
+    }
+
+    void calculate_transforms() {
+        const StreamTests &tests = fused_state(TEST_TRANSFORMS).get_tests();
+        transforms = tests.transforms ? tests.transforms->result() : Transforms(transformLag).result();
+    }
+
+    void calculate_float_fields() {
+        const StreamTests &tests = fused_state(TEST_FLOAT_FIELDS).get_tests();
+        floatFields = tests.floats ? tests.floats->result() : FloatFields(floatBits, floatOrder).result();
+    }
+
+    void calculate_columns() {
+        const StreamTests &tests = fused_state(TEST_COLUMNS).get_tests();
+        columns = tests.columns ? tests.columns->result() : Columns(recordSize).result();
+    }
+
+    // Bytes come from the streaming pass. Bit planes of other symbol widths are counted over
+    // the symbols in memory, the changes of a plane being the set bits of s ^ previous.
+    void calculate_bit_positions() {
+        if constexpr (symbol_mode()) {
+            constexpr uint32_t width = Policy::symbolBits;
+            std::array<uint64_t, 32> ones{};
+            std::array<uint64_t, 32> changes{};
+            uint64_t samples = 0;
+            uint32_t first = 0;
+            uint32_t previous = 0;
+            for_each_symbol([&](uint32_t symbol) {
+                if (samples++ == 0) {
+                    first = previous = symbol;
+                }
+                uint32_t changed = symbol ^ previous;
+                for (uint32_t b = 0; b < width; ++b) {
+                    ones[b] += (symbol >> b) & 1;
+                    changes[b] += (changed >> b) & 1;
+                }
+                previous = symbol;
+            });
+            bitPositions.clear();
+            for (uint32_t b = 0; b < width; ++b) {
+                bitPositions.push_back(BitPositions::position_result(b, samples, ones[b], changes[b], (first >> b) & 1, (previous >> b) & 1));
+            }
+        } else {
+            const StreamTests &tests = fused_state(TEST_BIT_POSITIONS).get_tests();
+            bitPositions = tests.positions ? tests.positions->result() : BitPositions().result();
+        }
+    }
+
+    // Poker, gap and coupon collector tests from the streaming pass
+    void calculate_knuth() {
+        const StreamTests &tests = fused_state(TEST_KNUTH).get_tests();
+        knuth = tests.symbols ? tests.symbols->result() : SymbolTests(knuthSymbolBits).result();
+    }
+
+    std::vector<size_t> strongest_lags(size_t count) const {
+        std::vector<size_t> lags(autocorrelation.size());
+        std::iota(lags.begin(), lags.end(), 1);
+        count = std::min(count, lags.size());
+        std::partial_sort(lags.begin(), lags.begin() + count, lags.end(), [&](size_t a, size_t b) {
+            return std::fabs(autocorrelation[a - 1]) > std::fabs(autocorrelation[b - 1]);
+        });
+        lags.resize(count);
+        return lags;
+    }
+
+    void calculate_bit_battery() {
+        const StreamTests &tests = fused_state(TEST_BIT_BATTERY).get_tests();
+        bitBattery = tests.battery ? tests.battery->result() : BitBattery().result();
+    }
+
+    void calculate_matrix_rank() {
+        const StreamTests &tests = fused_state(TEST_MATRIX_RANK).get_tests();
+        matrixRank = tests.rank ? tests.rank->result() : MatrixRank().result();
+    }
+
+    void calculate_linear_complexity() {
+        const StreamTests &tests = fused_state(TEST_LINEAR_COMPLEXITY).get_tests();
+        linearComplexity = tests.linear ? tests.linear->result() : LinearComplexity(linearComplexityBits).result();
+    }
+
+    void calculate_universal() {
+        const StreamTests &tests = fused_state(TEST_UNIVERSAL).get_tests();
+        universal = tests.universal ? tests.universal->result() : Universal().result();
+    }
+
+    void calculate_patterns() {
+        const StreamTests &tests = fused_state(TEST_PATTERNS).get_tests();
+        patterns = tests.patterns ? tests.patterns->result() : Patterns(patternLength).result();
+    }
+
+    // Correlation coefficients of bytes autocorrelationLags apart and closer. Each block of
+    // the data is correlated with itself extended by the lags through one FFT of both,
+    // packed as the real and imaginary parts, and the blocks run in parallel.
+    void calculate_autocorrelation() {
+        size_t n = data.size();
+        size_t lags = std::min(autocorrelationLags, n > 0 ? n - 1 : 0);
+        autocorrelation.assign(lags, 0.0);
+        if (lags == 0) {
+            return;
+        }
+
+        build_histogram();
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            sum += double(value) * histogram[value];
+            sumSquares += double(value) * value * histogram[value];
+        }
+        double mean = sum / n;
+        double variance = sumSquares - sum * mean;
+        if (variance <= 0.0) {
+            autocorrelation.assign(lags, std::nan(""));
+            return;
+        }
+
+        Fft fft(std::max<size_t>(AUTOCORRELATION_MIN_FFT, std::bit_ceil(4 * lags)));
+        size_t size = fft.get_size();
+        size_t blockSize = size - lags;
+        size_t blocks = (n + blockSize - 1) / blockSize;
+        size_t parts = std::min<size_t>(blocks, std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<std::vector<double>> products(parts, std::vector<double>(lags + 1, 0.0));
+        parallel_for(parts, [&](size_t part) {
+            std::vector<std::complex<double>> packed(size);
+            std::vector<std::complex<double>> cross(size);
+            for (size_t block = part; block < blocks; block += parts) {
+                size_t begin = block * blockSize;
+                size_t end = std::min(n, begin + blockSize);
+                size_t reach = std::min(n, end + lags);
+                with_byte_map([&](auto map) {
+                    for (size_t i = 0; i < size; ++i) {
+                        double extended = begin + i < reach ? map(data[begin + i]) - mean : 0.0;
+                        packed[i] = {begin + i < end ? extended : 0.0, extended};
+                    }
+                });
+                fft.transform(packed.data());
+                // Separate the two real spectra A and B, and form conj(A) B
+                for (size_t k = 0; k < size; ++k) {
+                    std::complex<double> mirror = std::conj(packed[(size - k) & (size - 1)]);
+                    std::complex<double> a = 0.5 * (packed[k] + mirror);
+                    std::complex<double> b = std::complex<double>(0.0, -0.5) * (packed[k] - mirror);
+                    cross[k] = std::conj(a) * b;
+                }
+                fft.transform(cross.data(), true);
+                for (size_t lag = 1; lag <= lags; ++lag) {
+                    products[part][lag] += cross[lag].real() / double(size);
+                }
+            }
+        });
+        for (size_t lag = 1; lag <= lags; ++lag) {
+            double product = 0.0;
+            for (size_t part = 0; part < parts; ++part) {
+                product += products[part][lag];
+            }
+            autocorrelation[lag - 1] = product / variance;
+        }
+    }
+
+    // Runs fn(index) for every index in [0, count) spread over the available cores
+    template <typename F>
+    static void parallel_for(size_t count, F fn) {
+        size_t workers = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; ++i) {
+                fn(i);
+            }
+            return;
+        }
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < workers; ++t) {
+            threads.emplace_back([&]() {
+                for (size_t i = next++; i < count; i = next++) {
+                    fn(i);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+
+    // LSD radix sort of keys below 2^keyBits in RADIX_BITS digits. Each pass is split over
+    // parts chunks: per-chunk digit counts give every chunk its own output positions, so the
+    // chunks scatter in parallel and the sort stays stable. Passes where all keys share the
+    // digit are skipped.
+    static void radix_sort(std::vector<uint64_t> &values, std::vector<uint64_t> &scratch, uint32_t keyBits, size_t parts) {
+        constexpr size_t buckets = size_t(1) << RADIX_BITS;
+        size_t n = values.size();
+        parts = std::max<size_t>(1, std::min(parts, n / buckets));
+        size_t chunk = (n + parts - 1) / parts;
+        std::vector<std::array<size_t, buckets>> positions(parts);
+        for (uint32_t shift = 0; shift < keyBits; shift += RADIX_BITS) {
+            parallel_for(parts, [&](size_t part) {
+                positions[part].fill(0);
+                for (size_t i = part * chunk; i < std::min(n, (part + 1) * chunk); ++i) {
+                    positions[part][(values[i] >> shift) & (buckets - 1)]++;
+                }
+            });
+            size_t offset = 0;
+            bool single = false;
+            for (size_t digit = 0; digit < buckets; ++digit) {
+                size_t count = 0;
+                for (size_t part = 0; part < parts; ++part) {
+                    count += positions[part][digit];
+                }
+                single = single || count == n;
+                for (size_t part = 0; part < parts; ++part) {
+                    size_t partCount = positions[part][digit];
+                    positions[part][digit] = offset;
+                    offset += partCount;
+                }
+            }
+            if (single) {
+                continue;
+            }
+            parallel_for(parts, [&](size_t part) {
+                for (size_t i = part * chunk; i < std::min(n, (part + 1) * chunk); ++i) {
+                    scratch[positions[part][(values[i] >> shift) & (buckets - 1)]++] = values[i];
+                }
+            });
+            values.swap(scratch);
+        }
+    }
+
+    // Estimated LZ4-style sequence cost of a literal run followed by a match
+    static size_t lz_sequence_cost(size_t literals, size_t matchLength) {
+        size_t cost = 1 + literals;
+        if (literals >= 15) {
+            cost += 1 + (literals - 15) / 255;
+        }
+        if (matchLength > 0) {
+            cost += 2;
+            if (matchLength - LZ_MIN_MATCH >= 15) {
+                cost += 1 + (matchLength - LZ_MIN_MATCH - 15) / 255;
+            }
+        }
+        return cost;
+    }
+
+    // Greedy hash-chain parse of one block, returns its estimated compressed size.
+    // head and chain are per-thread scratch tables reused between blocks; map translates
+    // each byte as the match finder reads it.
+    template <typename Map>
+    static size_t lz_estimate_block(const unsigned char *block, size_t size, std::vector<int32_t> &head, std::vector<int32_t> &chain, Map map) {
+        std::fill(head.begin(), head.end(), -1);
+        auto hash = [block, map](size_t pos) {
+            uint32_t v = uint32_t(map(block[pos])) | uint32_t(map(block[pos+1])) << 8 | uint32_t(map(block[pos+2])) << 16 | uint32_t(map(block[pos+3])) << 24;
+            return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+        };
+        auto insert = [&](size_t pos) {
+            uint32_t h = hash(pos);
+            chain[pos & (LZ_WINDOW_SIZE - 1)] = head[h];
+            head[h] = int32_t(pos);
+        };
+
+        size_t cost = 0;
+        size_t literals = 0;
+        size_t pos = 0;
+        while (pos + LZ_MIN_MATCH <= size) {
+            size_t bestLength = 0;
+            int32_t candidate = head[hash(pos)];
+            for (int depth = 0; candidate >= 0 && depth < LZ_MAX_CHAIN; ++depth) {
+                size_t cand = size_t(candidate);
+                if (pos - cand >= LZ_WINDOW_SIZE) {
+                    break;
+                }
+                size_t length = 0;
+                while (pos + length < size && map(block[cand + length]) == map(block[pos + length])) {
+                    ++length;
+                }
+                if (length > bestLength) {
+                    bestLength = length;
+                }
+                candidate = chain[cand & (LZ_WINDOW_SIZE - 1)];
+            }
+
+            if (bestLength >= LZ_MIN_MATCH) {
+                cost += lz_sequence_cost(literals, bestLength);
+                literals = 0;
+                size_t end = pos + bestLength;
+                for (; pos < end; ++pos) {
+                    if (pos + LZ_MIN_MATCH <= size) {
+                        insert(pos);
+                    }
+                }
+            } else {
+                insert(pos);
+                ++literals;
+                ++pos;
+            }
+        }
+        literals += size - pos;
+        return cost + lz_sequence_cost(literals, 0);
+    }
+
+    void calculate_lz_compression() {
+        if (loadedState) {
+            // A state keeps no bytes to search for matches
+            lz_size = lz_compression = std::nan("");
+            return;
+        }
+        size_t blocks = (data.size() + LZ_BLOCK_SIZE - 1) / LZ_BLOCK_SIZE;
+        size_t stride = std::max<size_t>(1, lzSampleStride);
+        size_t sampled = (blocks + stride - 1) / stride;
+        std::vector<size_t> blockCost(sampled, 0);
+        std::vector<size_t> blockSize(sampled, 0);
+
+        // One worker per core, each owning its match finder tables and every workers-th block
+        size_t workers = std::min<size_t>(sampled, std::max(1u, std::thread::hardware_concurrency()));
+        parallel_for(workers, [&](size_t w) {
+            std::vector<int32_t> head(size_t(1) << LZ_HASH_BITS);
+            std::vector<int32_t> chain(LZ_WINDOW_SIZE, -1);
+            for (size_t i = w; i < sampled; i += workers) {
+                size_t offset = i * stride * LZ_BLOCK_SIZE;
+                size_t size = std::min<size_t>(LZ_BLOCK_SIZE, data.size() - offset);
+                blockSize[i] = size;
+                blockCost[i] = with_byte_map([&](auto map) { return lz_estimate_block(data.data() + offset, size, head, chain, map); });
+            }
+        });
+
+        double scanned = std::accumulate(blockSize.begin(), blockSize.end(), 0.0);
+        double cost = std::accumulate(blockCost.begin(), blockCost.end(), 0.0);
+        lz_size = scanned > 0 ? cost * data.size() / scanned : 0.0;
+        lz_compression = data.empty() ? 0.0 : std::max(0.0, 100.0 * (1.0 - lz_size / data.size()));
+    }
+public:
+    BasicEnt(const std::string &filePath) {
+        buffer = load_file_data(filePath);
+        data = buffer;
+    }
 
-        std::cout << "\nTotal: " << data.size() << " 1.0\n\n";
+    BasicEnt() {
+        std::istreambuf_iterator<char> start(std::cin), end;
+        buffer = {start, end};
+        data = buffer;
     }
 
-    void print_result_terse() {
-        std::string samp = streamOfBitsMode ? "bit" : "byte";
-        int totalc = streamOfBitsMode ? (data.size()*8) : (data.size());
-        std::cout << "0,File-"+ samp +"s,Entropy,Chi-square,Mean,Monte-Carlo-Pi,Serial-Correlation\n1,";
-        std::cout << totalc << "," << entropy << "," << chisquare << "," << mean << "," << pi_estimate << "," << serial_correlation << "\n";
+    // Analyzes bytes owned by the caller in place, they must outlive the calculations
+    BasicEnt(std::span<const std::byte> bytes) {
+        setData(bytes);
     }
 
-    void print_table_terse() {
-        std::cout << "2,Value,Occurrences,Fraction\n";
-        if (streamOfBitsMode) {
-            std::vector<int> bitOccurrences(2, 0);
-    
-            // Iterate over each byte and then each bit within that byte
-            for (auto &byte : data) {
-                for(int bit=0; bit<8; bit++) {
-                    int bitValue = (byte >> bit) & 1;
-                    bitOccurrences[bitValue]++;
-                }
-            }
-            for(int i=0; i<2; ++i) {
-                std::cout << "3," << i << "," << bitOccurrences[i] << "," << (bitOccurrences[i] / static_cast<double>(data.size()*8)) << "\n";
-            }
-        } else {
-            std::vector<int> byteOccurrences(256, 0);
-    
-            // Iterate over each byte
-            for (auto &byte : data) {
-                byteOccurrences[byte]++;
-            }
-            for(int i=0; i<256; ++i) {
-                std::cout << "3," << i << "," << byteOccurrences[i] << "," << (byteOccurrences[i] / static_cast<double>(data.size())) << "\n";
-            }
+    // Points the instance at new caller owned bytes without copying them. Modes and
+    // settings are kept, memoized results are dropped.
+    void setData(std::span<const std::byte> bytes) {
+        if (!buffer.empty()) {
+            std::vector<unsigned char>().swap(buffer);
         }
+        data = {reinterpret_cast<const unsigned char *>(bytes.data()), bytes.size()};
+        loadedState.reset();
+        invalidate();
     }
 
-    // Numerical approximation of the CDF for a standard normal distribution
-    double norm_cdf(double x) {
-        return 0.5 * erfc(-x * M_SQRT1_2);
+    void setData(std::string_view text) {
+        setData(std::as_bytes(std::span<const char>(text.data(), text.size())));
     }
 
-    void calculate_entropy() {
-        if (streamOfBitsMode) {
-            std::vector<double> frequencies(2, 0);  // Frequencies for 2 possible bit values: 0 and 1
-    
-            for (auto &byte : data) {
-                for(int bit=0; bit<8; bit++) {
-                    int bitValue = (byte >> bit) & 1;
-                    frequencies[bitValue]++;
-                }
-            }
-    
-            entropy = 0.0;
-            double totalBits = 8.0 * data.size();
-            for (auto &frequency : frequencies) {
-                frequency /= totalBits;
-                if (frequency > 0) {
-                    entropy -= frequency * (std::log2(frequency));
-                }
+    // Streams a file through the accumulator one chunk at a time instead of loading it,
+    // so inputs of any size can be analyzed; each chunk is split over all cores. With a
+    // checkpoint file set, the state and offset are saved every checkpoint interval, and
+    // in resume mode the scan continues from a saved checkpoint. Afterwards the instance
+    // reports on the scanned state as with setState(). Returns false if the file cannot
+    // be read or the checkpoint does not belong to this scan, or to the file as it is now.
+    bool scanFile(const std::string &filePath) {
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        std::error_code error;
+        uint64_t fileSize = std::filesystem::file_size(filePath, error);
+        StreamTests tests = stream_tests(error ? 0 : fileSize);
+        bool regular = !error && std::filesystem::is_regular_file(filePath, error);
+
+        // A checkpoint belongs to a regular file of the same size and modification time
+        std::optional<SourceIdentity> source;
+        if (regular) {
+            auto modified = std::filesystem::last_write_time(filePath, error);
+            if (!error) {
+                source = SourceIdentity{fileSize, int64_t(modified.time_since_epoch().count())};
             }
-    
-            // Calculate the optimal compression percentage
-            double max_entropy = 1.0;  // Max entropy in bits per bit
-            compression = 100.0 * (1.0 - entropy / max_entropy);
-        } else {
-            std::vector<double> frequencies(BYTE_VAL_COUNT, 0);
-    
-            for (auto &byte : data) {
-                frequencies[byte]++;
+        }
+        State state(0, foldCaseMode, tests);
+        if (resumeMode && !checkpointPath.empty() && std::filesystem::exists(checkpointPath)) {
+            if (!state.load(checkpointPath) || state.get_offset() != 0 || state.get_fold_case() != foldCaseMode || !state.get_tests().compatible(tests) || state.get_source() != source) {
+                return false;
             }
-    
-            entropy = 0.0;
-            for (auto &frequency : frequencies) {
-                frequency /= data.size();
-                if (frequency > 0) {
-                    entropy -= frequency * (std::log2(frequency));
-                }
+            file.seekg(state.get_length());
+            if (!file) {
+                return false;
             }
-    
-            // Calculate the optimal compression percentage
-            double max_entropy = 8.0;  // Max entropy in bits per byte
-            compression = 100.0 * (1.0 - entropy / max_entropy);
         }
-    }
 
+        std::vector<unsigned char> chunk(SCAN_CHUNK_SIZE);
+        uint64_t lastCheckpoint = state.get_length();
+        // Per-core partial states of a chunk merge into exactly the sequential result; the
+        // coupon segments of the state carry on through the chunk
+        auto append = [&](std::span<const unsigned char> bytes) {
+            StreamTests next = tests;
+            if (next.symbols) {
+                next.symbols->continue_coupons(*state.get_tests().symbols);
+            }
+            state.merge(accumulate(bytes, state.get_offset() + state.get_length(), next));
+        };
+        auto checkpoint = [&]() {
+            if (!checkpointPath.empty() && checkpointInterval > 0 && state.get_length() - lastCheckpoint >= checkpointInterval) {
+                state.set_source(source);
+                if (!state.save(checkpointPath)) {
+                    return false;
+                }
+                lastCheckpoint = state.get_length();
+            }
+            return true;
+        };
 
-    void calculate_chisquare() {
-        if (streamOfBitsMode) {
-            double expected = 8.0 * data.size() / 2.0;  // For bits, only two possibilities 0 and 1
-            std::vector<int> observed(2, 0);  // For bits
-    
-            for (auto &byte : data) {
-                for(int bit=0; bit<8; bit++) {
-                    int bitValue = (byte >> bit) & 1;
-                    observed[bitValue]++;
+        // Only the data regions of a sparse file are read; its holes are runs of zeros,
+        // added in closed form or, for the optional tests, from a chunk of zeros
+        auto skip_hole = [&](uint64_t end) {
+            while (state.get_length() < end) {
+                uint64_t size = std::min<uint64_t>(end - state.get_length(), SCAN_CHUNK_SIZE);
+                if (tests.empty()) {
+                    state.update_zeros(size);
+                } else {
+                    std::fill(chunk.begin(), chunk.begin() + size, 0);
+                    append(std::span<const unsigned char>(chunk.data(), size));
+                }
+                if (!checkpoint()) {
+                    return false;
                 }
             }
-    
-            chisquare = 0.0;
-            for (int i = 0; i < 2; ++i) {
-                double diff = observed[i] - expected;
-                chisquare += diff * diff / expected;
+            return true;
+        };
+
+        std::vector<std::pair<uint64_t, uint64_t>> extents = regular ? data_extents(filePath, fileSize) : std::vector<std::pair<uint64_t, uint64_t>>{{0, UINT64_MAX}};
+        for (auto [start, size] : extents) {
+            uint64_t end = regular ? start + size : UINT64_MAX;
+            if (state.get_length() >= end) {
+                continue;
             }
-    
-            int degree_of_freedom = 1;  // For bits
-    
-            // Transform Chi-square to z-value
-            double z = std::sqrt(chisquare - degree_of_freedom);
-    
-            // Calculate p-value from standard normal distribution
-            p_value = 1 - norm_cdf(z);
-        } else {
-            double expected = data.size() / static_cast<double>(BYTE_VAL_COUNT);
-            std::vector<int> observed(BYTE_VAL_COUNT, 0);
-    
-            for (auto &byte : data) {
-                observed[byte]++;
+            if (!skip_hole(start)) {
+                return false;
             }
-    
-            chisquare = 0.0;
-            for (int i = 0; i < BYTE_VAL_COUNT; ++i) {
-                double diff = observed[i] - expected;
-                chisquare += diff * diff / expected;
+            if (regular) {
+                file.seekg(state.get_length());
+            }
+            while (file && state.get_length() < end) {
+                file.read(reinterpret_cast<char *>(chunk.data()), std::min<uint64_t>(chunk.size(), end - state.get_length()));
+                size_t got = file.gcount();
+                if (got == 0) {
+                    break;
+                }
+                append(std::span<const unsigned char>(chunk.data(), got));
+                if (!checkpoint()) {
+                    return false;
+                }
+            }
+            if (!file) {
+                break;
             }
-    
-            int degree_of_freedom = BYTE_VAL_COUNT - 1;
-    
-            // Transform Chi-square to z-value
-            double z = std::sqrt(chisquare - degree_of_freedom);
-    
-            // Calculate p-value from standard normal distribution
-            p_value = 1 - norm_cdf(z);
         }
-    }
-
+        if (file.bad()) {
+            return false;
+        }
+        if (regular && file && !skip_hole(fileSize)) {
+            return false;
+        }
+        state.set_source(source);
+        if (!checkpointPath.empty() && !state.save(checkpointPath)) {
+            return false;
+        }
 
-    void calculate_mean() {
-        double sum = std::accumulate(data.begin(), data.end(), 0.0);
-        mean = sum / data.size();
+        setState(state);
+        return true;
     }
 
-    void calculate_pi() {
-        unsigned long long radiusSquared = static_cast<unsigned long long>(1) << 48;
-
-        unsigned long hits = 0;
-        unsigned long total = 0;
-
-        for (size_t i = 0; i < data.size() - 5; i += 6) {
-            unsigned long long x = static_cast<unsigned long long>(data[i]) << 16 | static_cast<unsigned long long>(data[i+1]) << 8 | data[i+2];
-            unsigned long long y = static_cast<unsigned long long>(data[i+3]) << 16 | static_cast<unsigned long long>(data[i+4]) << 8 | data[i+5];
-
-            unsigned long long distanceSquared = x * x + y * y;
+    // Analyzes byteCount bytes pulled straight from generators, without going through a file.
+    // makeGenerator(index) is called once per worker thread and must return a generator
+    // seeded distinctly for that index: a callable yielding unsigned words (such as a std::
+    // engine) or a range of unsigned words. The workers' outputs are analyzed as if
+    // concatenated in index order. Afterwards the instance reports as with setState().
+    // Returns the number of bytes analyzed: less than byteCount if a range ran out early,
+    // as the outputs of the workers after it cannot be stitched on and are left out.
+    // The coupon collector test of the Knuth tests follows its segments through the
+    // outputs in order, so with those tests selected the outputs of all workers but the
+    // first are generated a second time, one after the other, from makeGenerator(index)
+    // called again; it must then return the same output for the same index.
+    template <typename Factory>
+    uint64_t analyzeGenerator(Factory makeGenerator, uint64_t byteCount) {
+        size_t workers = std::max(1u, std::thread::hardware_concurrency());
+        StreamTests tests = stream_tests(byteCount);
+        uint64_t unit = tests.alignment();
+        uint64_t share = ((byteCount + workers - 1) / workers + unit - 1) / unit * unit;
+        std::vector<State> partial;
+        for (size_t w = 0; w < workers; ++w) {
+            partial.emplace_back(std::min(byteCount, w * share), foldCaseMode, tests);
+        }
 
-            if (distanceSquared < radiusSquared) {
-                hits++;
+        // Passes the output of worker w to consume chunk by chunk, with the stream position
+        // of each chunk. Returns the position reached, short of the share's end if a range
+        // ran out.
+        auto generate = [&](size_t w, auto consume) {
+            uint64_t position = std::min(byteCount, w * share);
+            uint64_t end = std::min(byteCount, (w + 1) * share);
+            auto generator = makeGenerator(w);
+            using Generator = decltype(generator);
+            auto run = [&](auto fill) {
+                std::vector<unsigned char> chunk(std::min<uint64_t>(GENERATOR_CHUNK_SIZE, end - position));
+                while (position < end) {
+                    size_t got = fill(chunk.data(), std::min<uint64_t>(chunk.size(), end - position));
+                    if (got == 0) {
+                        break;
+                    }
+                    consume(std::span<const unsigned char>(chunk.data(), got), position);
+                    position += got;
+                }
+            };
+            if constexpr (WordGenerator<Generator>) {
+                run([&](unsigned char *out, size_t size) { return generate_bytes(generator, out, size); });
+            } else {
+                static_assert(WordRange<Generator>, "makeGenerator must return a word generator or a range of words");
+                RangeCursor<Generator> cursor(generator);
+                run([&](unsigned char *out, size_t size) { return cursor.generate(out, size); });
+            }
+            return position;
+        };
+        std::vector<uint64_t> reached(workers);
+        parallel_for(workers, [&](size_t w) {
+            reached[w] = generate(w, [&](std::span<const unsigned char> chunk, uint64_t) { partial[w].update(chunk); });
+        });
+        if (tests.symbols) {
+            // The other workers cannot know where their coupon segments start, so the first
+            // one follows them through the outputs after its own, as in accumulate()
+            for (size_t w = 1; w < workers && reached[w - 1] == std::min(byteCount, w * share); ++w) {
+                generate(w, [&](std::span<const unsigned char> chunk, uint64_t position) { partial[0].update_coupons(chunk, position); });
             }
-            total++;
         }
 
-        pi_estimate = 4.0 * hits / total;
+        State state = partial[0];
+        for (size_t w = 1; w < workers; ++w) {
+            if (!state.merge(partial[w])) {
+                break;  // An exhausted range leaves a gap, the rest cannot be stitched on
+            }
+        }
+        setState(state);
+        return state.get_length();
     }
 
-    void calculate_serial_correlation() {
-        unsigned long long sumX = 0;
-        unsigned long long sumY = 0;
-        unsigned long long sumXY = 0;
-        unsigned long long sumX2 = 0;
-        unsigned long long sumY2 = 0;
-
-        for (size_t i = 1; i < data.size(); ++i) {
-            unsigned long long X = data[i - 1];
-            unsigned long long Y = data[i];
-
-            sumX += X;
-            sumY += Y;
-            sumXY += X * Y;
-            sumX2 += X * X;
-            sumY2 += Y * Y;
+    // Accumulated state of the data, for merging with the states of adjacent shards.
+    // offset is the position of this data in the whole stream.
+    State get_state(uint64_t offset = 0) const {
+        if (loadedState) {
+            return *loadedState;
         }
-
-        double n = data.size() - 1;
-        serial_correlation = (n * sumXY - sumX * sumY) / std::sqrt((n * sumX2 - sumX * sumX) * (n * sumY2 - sumY * sumY));
-    }
-public:
-    Ent(const std::string &filePath) : streamOfBitsMode(false), printTableMode(false), foldCaseMode(false), terseMode(false), printResultMode(true) {
-        data = load_file_data(filePath);
-        entropy = 0.0;
-        compression = 0.0;
-        chisquare = 0.0;
-        p_value = 0.0;
-        mean = 0.0;
-        pi_estimate = 0.0;
-        serial_correlation = 0.0;
+        return accumulate(data, offset, stream_tests(data.size()));
     }
 
-    Ent() : streamOfBitsMode(false), printTableMode(false), foldCaseMode(false), terseMode(false), printResultMode(true) {
-        entropy = 0.0;
-        compression = 0.0;
-        chisquare = 0.0;
-        p_value = 0.0;
-        mean = 0.0;
-        pi_estimate = 0.0;
-        serial_correlation = 0.0;
-        std::istreambuf_iterator<char> start(std::cin), end;
-        data = {start, end};
+    // Analyzes a (merged) state instead of data. Tests that need the bytes themselves,
+    // such as the LZ estimate, are not available. A state holds byte statistics only, so
+    // with symbols other than bytes neither this nor scanFile() and analyzeGenerator(),
+    // which report through it, compile.
+    void setState(const State &state) {
+        static_assert(!symbol_mode(), "a State holds byte statistics, symbols of other widths need the data in memory");
+        setData(std::span<const std::byte>());
+        loadedState = state;
+        foldCaseMode = state.get_fold_case();
+        invalidate();
     }
 
+    // Runs the selected tests and prints them. In lazy mode only what is printed is computed,
+    // the getters compute the rest on first use.
     void calculate() {
-        if (foldCaseMode) {
-            for(std::vector<unsigned char>::size_type i = 0; i != data.size(); ++i) {
-                if (std::isalpha(data[i]) && std::isupper(data[i])) {
-                    data[i] = std::tolower(data[i]);
+        if (!lazyMode || printResultMode) {
+            for (unsigned test = 1; test <= TEST_ALL; test <<= 1) {
+                if (selected(test)) {
+                    ensure(test);
                 }
             }
         }
-        calculate_entropy();
-        calculate_chisquare();
-        calculate_mean();
-        calculate_pi();
-        calculate_serial_correlation();
         if (terseMode) {
             if (printResultMode && terseMode) {
                 print_result_terse();
@@ -338,6 +5229,48 @@ public:
             if (printResultMode && printTableMode) {
                 print_table_terse();
             }
+            if (printResultMode && selected(TEST_LZ)) {
+                print_lz_terse();
+            }
+            if (printResultMode && selected(TEST_BIT_BATTERY)) {
+                print_bit_battery_terse();
+            }
+            if (printResultMode && selected(TEST_AUTOCORRELATION)) {
+                print_autocorrelation_terse();
+            }
+            if (printResultMode && selected(TEST_SPECTRAL)) {
+                print_spectral_terse();
+            }
+            if (printResultMode && selected(TEST_MATRIX_RANK)) {
+                print_matrix_rank_terse();
+            }
+            if (printResultMode && selected(TEST_LINEAR_COMPLEXITY)) {
+                print_linear_complexity_terse();
+            }
+            if (printResultMode && selected(TEST_UNIVERSAL)) {
+                print_universal_terse();
+            }
+            if (printResultMode && selected(TEST_PATTERNS)) {
+                print_patterns_terse();
+            }
+            if (printResultMode && selected(TEST_BIRTHDAY)) {
+                print_birthday_terse();
+            }
+            if (printResultMode && selected(TEST_KNUTH)) {
+                print_knuth_terse();
+            }
+            if (printResultMode && selected(TEST_BIT_POSITIONS)) {
+                print_bit_positions_terse();
+            }
+            if (printResultMode && selected(TEST_COLUMNS)) {
+                print_columns_terse();
+            }
+            if (printResultMode && selected(TEST_FLOAT_FIELDS)) {
+                print_float_fields_terse();
+            }
+            if (printResultMode && selected(TEST_TRANSFORMS)) {
+                print_transforms_terse();
+            }
         } else {
             if (printResultMode && printTableMode) {
                 print_table();
@@ -348,8 +5281,10 @@ public:
         }
     }
 
+    // Has no effect unless the policy uses Sampling::Runtime
     void setStreamOfBitsMode(bool mode) {
         streamOfBitsMode = mode;
+        invalidate();
     }
 
     void setPrintTableMode(bool mode) {
@@ -358,6 +5293,7 @@ public:
 
     void setFoldCaseMode(bool mode) {
         foldCaseMode = mode;
+        invalidate();
     }
 
     void setTerseMode(bool mode) {
@@ -368,27 +5304,515 @@ public:
         printResultMode = mode;
     }
 
+    // Getters compute their statistic on first use instead of relying on calculate()
+    void setLazyMode(bool mode) {
+        lazyMode = mode;
+    }
+
+    // Bitwise or of Tests that calculate() runs, limited to the tests compiled in by the policy.
+    // The default is DEFAULT_TEST_MASK.
+    void setTestMask(unsigned mask) {
+        testMask = mask;
+    }
+
+    // Selects or deselects one of the Tests for calculate(), keeping the others
+    void setTestMode(Tests test, bool mode) {
+        testMask = mode ? (testMask | test) : (testMask & ~test);
+    }
+
+    // Used by scanFile(): the state is saved to path after every intervalBytes of input
+    void setCheckpointFile(const std::string &path, uint64_t intervalBytes) {
+        checkpointPath = path;
+        checkpointInterval = intervalBytes;
+    }
+
+    // scanFile() continues from the checkpoint file when one exists
+    void setResumeMode(bool mode) {
+        resumeMode = mode;
+    }
+
+    void setAutocorrelationLags(size_t lags) {
+        autocorrelationLags = lags;
+        invalidate();
+    }
+
+    // 32 or 64; 64-bit trials take 2^22 birthdays, 32 MiB of input each
+    void setBirthdaySampleBits(uint32_t bits) {
+        birthdaySampleBits = bits > 32 ? 64 : 32;
+        invalidate();
+    }
+
+    // Symbol width of the poker, gap and coupon collector tests: 1, 2, 4 or 8 bits
+    void setKnuthSymbolBits(uint32_t bits) {
+        knuthSymbolBits = std::bit_floor(std::clamp<uint32_t>(bits, 1, 8));
+        invalidate();
+    }
+
+    // Distance k of the XOR with the byte k positions back, 1 to TRANSFORM_MAX_LAG
+    void setTransformLag(uint32_t lag) {
+        transformLag = std::clamp<uint32_t>(lag, 1, TRANSFORM_MAX_LAG);
+        invalidate();
+    }
+
+    // 32 for float32, 64 for float64 values
+    void setFloatBits(uint32_t bits) {
+        floatBits = bits > 32 ? 64 : 32;
+        invalidate();
+    }
+
+    // Byte order the float values are stored in, little endian by default
+    void setFloatOrder(Endian order) {
+        floatOrder = order;
+        invalidate();
+    }
+
+    // Record size of the column statistics, 1 to COLUMN_MAX_RECORD bytes
+    void setRecordSize(uint32_t bytes) {
+        recordSize = std::clamp<uint32_t>(bytes, 1, COLUMN_MAX_RECORD);
+        invalidate();
+    }
+
+    // Longest pattern length m of the serial and approximate entropy tests, 2 to 16 bits
+    void setPatternLength(uint32_t bits) {
+        patternLength = std::clamp<uint32_t>(bits, 2, PATTERN_MAX_LENGTH);
+        invalidate();
+    }
+
+    // Block size L of the universal test, 6 to 16 bits; 0 picks the SP 800-22 choice for the input length
+    void setUniversalBlockSize(uint32_t bits) {
+        universalBits = bits == 0 ? 0 : std::clamp<uint32_t>(bits, UNIVERSAL_MIN_BLOCK, UNIVERSAL_MAX_BLOCK);
+        invalidate();
+    }
+
+    // Block size M of the linear complexity test in bits, rounded down to a multiple of 8
+    void setLinearComplexityBlockSize(uint32_t bits) {
+        linearComplexityBits = bits;
+        invalidate();
+    }
+
+    // Block size of the spectral test in bits, rounded down to a power of two of at least 64
+    void setSpectralBlockSize(uint32_t bits) {
+        spectralBlockBits = std::bit_floor(std::max<uint32_t>(64, bits));
+        invalidate();
+    }
+
+    // Block size M of the block frequency test in bits, rounded down to a multiple of 64
+    void setBlockFrequencySize(uint32_t bits) {
+        blockFrequencyBits = bits;
+        invalidate();
+    }
+
+    // Only every stride:th LZ_BLOCK_SIZE block is parsed and the result is extrapolated
+    void setLzSampleStride(size_t stride) {
+        lzSampleStride = stride;
+        computedTests &= ~TEST_LZ;
+    }
+
     double get_entropy() {
+        if (lazyMode) {
+            ensure(TEST_ENTROPY);
+        }
         return entropy;
     }
     double get_compression() {
+        if (lazyMode) {
+            ensure(TEST_ENTROPY);
+        }
         return compression;
     }
     double get_chisquare() {
+        if (lazyMode) {
+            ensure(TEST_CHISQUARE);
+        }
         return chisquare;
     }
     double get_p_value() {
+        if (lazyMode) {
+            ensure(TEST_CHISQUARE);
+        }
         return p_value;
     }
     double get_mean() {
+        if (lazyMode) {
+            ensure(TEST_MEAN);
+        }
         return mean;
     }
     double get_pi_estimate() {
+        if (lazyMode) {
+            ensure(TEST_PI);
+        }
         return pi_estimate;
     }
     double get_serial_correlation() {
+        if (lazyMode) {
+            ensure(TEST_SERIAL_CORRELATION);
+        }
         return serial_correlation;
     }
+    double get_lz_size() {
+        if (lazyMode) {
+            ensure(TEST_LZ);
+        }
+        return lz_size;
+    }
+    double get_lz_compression() {
+        if (lazyMode) {
+            ensure(TEST_LZ);
+        }
+        return lz_compression;
+    }
+    BitBatteryResult get_bit_battery() {
+        if (lazyMode) {
+            ensure(TEST_BIT_BATTERY);
+        }
+        return bitBattery;
+    }
+    // Element k - 1 is the correlation coefficient at lag k
+    std::vector<double> get_autocorrelation() {
+        if (lazyMode) {
+            ensure(TEST_AUTOCORRELATION);
+        }
+        return autocorrelation;
+    }
+    // Lags with the largest absolute correlation, strongest first
+    std::vector<size_t> get_strongest_lags(size_t count) {
+        if (lazyMode) {
+            ensure(TEST_AUTOCORRELATION);
+        }
+        return strongest_lags(count);
+    }
+    SpectralResult get_spectral() {
+        if (lazyMode) {
+            ensure(TEST_SPECTRAL);
+        }
+        return spectral;
+    }
+    MatrixRankResult get_matrix_rank() {
+        if (lazyMode) {
+            ensure(TEST_MATRIX_RANK);
+        }
+        return matrixRank;
+    }
+    LinearComplexityResult get_linear_complexity() {
+        if (lazyMode) {
+            ensure(TEST_LINEAR_COMPLEXITY);
+        }
+        return linearComplexity;
+    }
+    UniversalResult get_universal() {
+        if (lazyMode) {
+            ensure(TEST_UNIVERSAL);
+        }
+        return universal;
+    }
+    BirthdayResult get_birthday() {
+        if (lazyMode) {
+            ensure(TEST_BIRTHDAY);
+        }
+        return birthday;
+    }
+    KnuthResult get_knuth() {
+        if (lazyMode) {
+            ensure(TEST_KNUTH);
+        }
+        return knuth;
+    }
+    FloatFieldResult get_float_fields() {
+        if (lazyMode) {
+            ensure(TEST_FLOAT_FIELDS);
+        }
+        return floatFields;
+    }
+    // Byte delta, XOR with the previous byte and XOR with the byte k back, in that order
+    std::vector<TransformResult> get_transforms() {
+        if (lazyMode) {
+            ensure(TEST_TRANSFORMS);
+        }
+        return transforms;
+    }
+    // Results by offset within the record
+    std::vector<ColumnResult> get_columns() {
+        if (lazyMode) {
+            ensure(TEST_COLUMNS);
+        }
+        return columns;
+    }
+    // Results by bit position, 0 the least significant
+    std::vector<BitPositionResult> get_bit_positions() {
+        if (lazyMode) {
+            ensure(TEST_BIT_POSITIONS);
+        }
+        return bitPositions;
+    }
+    // Serial and approximate entropy results for m = 2 to the pattern length
+    std::vector<PatternResult> get_patterns() {
+        if (lazyMode) {
+            ensure(TEST_PATTERNS);
+        }
+        return patterns;
+    }
+};
+
+// Raised by Monitor when a continuous health test trips
+struct HealthAlarm {
+    enum Test {
+        REPETITION_COUNT,
+        ADAPTIVE_PROPORTION
+    };
+    Test test;
+    uint64_t offset;  // Position of the sample that tripped the test
+    unsigned count;
+    unsigned cutoff;
+};
+
+// Long-running health monitor for entropy sources. Runs the SP 800-90B repetition count
+// and adaptive proportion tests on every byte and keeps entropy, chi-square, mean and
+// serial correlation over a rolling window. All buffers are allocated up front, so the
+// sample path does not allocate.
+class Monitor {
+private:
+    std::vector<unsigned char> window;  // Ring buffer of the last windowSize bytes
+    size_t windowSize;
+    size_t windowStart;
+    size_t windowFill;
+    std::array<uint64_t, BYTE_VAL_COUNT> histogram;
+    uint64_t productSum;  // Sum of products of adjacent bytes inside the window
+    uint64_t samples;
+
+    unsigned repetitionCutoff;
+    unsigned char repetitionValue;
+    unsigned repetitionCount;
+    uint64_t repetitionAlarms;
+
+    unsigned proportionCutoff;
+    unsigned char proportionValue;
+    unsigned proportionCount;
+    unsigned proportionSeen;
+    uint64_t proportionAlarms;
+
+    std::function<void(const HealthAlarm &)> alarmCallback;
+    std::string metricsPath;  // Empty until setMetricsFile()
+    std::string metricsTemporary;
+    uint64_t metricsInterval;
+    uint64_t nextMetrics;
+    std::array<char, 2048> metricsText;
+    std::atomic<bool> stopRequested;
+
+    // Smallest k with P(X <= k) >= 1 - 2^-HEALTH_FALSE_ALARM_BITS for X ~ Binomial(trials, p)
+    static unsigned critical_binomial(unsigned trials, double p) {
+        double target = 1.0 - std::ldexp(1.0, -HEALTH_FALSE_ALARM_BITS);
+        double cdf = 0.0;
+        for (unsigned k = 0; k <= trials; ++k) {
+            cdf += std::exp(std::lgamma(trials + 1.0) - std::lgamma(k + 1.0) - std::lgamma(trials - k + 1.0) + k * std::log(p) + (trials - k) * std::log1p(-p));
+            if (cdf >= target) {
+                return k;
+            }
+        }
+        return trials;
+    }
+
+    void raise(HealthAlarm::Test test, unsigned count, unsigned cutoff) {
+        if (alarmCallback) {
+            alarmCallback(HealthAlarm{test, samples, count, cutoff});
+        }
+    }
+
+    void health_tests(unsigned char byte) {
+        if (repetitionCutoff == 0) {
+            return;  // No valid min-entropy, no cutoffs
+        }
+        if (samples > 0 && byte == repetitionValue) {
+            if (++repetitionCount == repetitionCutoff) {
+                repetitionAlarms++;
+                raise(HealthAlarm::REPETITION_COUNT, repetitionCount, repetitionCutoff);
+            }
+        } else {
+            repetitionValue = byte;
+            repetitionCount = 1;
+        }
+
+        if (proportionSeen == 0) {
+            proportionValue = byte;
+            proportionCount = 1;
+        } else if (byte == proportionValue) {
+            if (++proportionCount == proportionCutoff) {
+                proportionAlarms++;
+                raise(HealthAlarm::ADAPTIVE_PROPORTION, proportionCount, proportionCutoff);
+            }
+        }
+        if (++proportionSeen == HEALTH_APT_WINDOW) {
+            proportionSeen = 0;
+        }
+    }
+
+    void roll_window(unsigned char byte) {
+        if (windowFill == windowSize) {
+            unsigned char oldest = window[windowStart];
+            unsigned char next = window[(windowStart + 1) % windowSize];
+            histogram[oldest]--;
+            productSum -= uint64_t(oldest) * next;
+            windowStart = (windowStart + 1) % windowSize;
+            windowFill--;
+        }
+        if (windowFill > 0) {
+            productSum += uint64_t(window[(windowStart + windowFill - 1) % windowSize]) * byte;
+        }
+        window[(windowStart + windowFill) % windowSize] = byte;
+        histogram[byte]++;
+        windowFill++;
+    }
+
+    // Formats the metrics into the fixed buffer and replaces the metrics file with them, so
+    // a scraper reads either the previous or the new export in full. The file is not synced
+    // to disk, a crash may lose the last export. Returns false if the text does not fit in
+    // the buffer or the file cannot be written.
+    bool export_metrics() {
+        if (metricsPath.empty()) {
+            return false;
+        }
+        int length = std::snprintf(metricsText.data(), metricsText.size(),
+            "# TYPE ent_samples_total counter\nent_samples_total %llu\n"
+            "# TYPE ent_window_bytes gauge\nent_window_bytes %llu\n"
+            "# TYPE ent_window_entropy_bits gauge\nent_window_entropy_bits %.6f\n"
+            "# TYPE ent_window_chisquare gauge\nent_window_chisquare %.6f\n"
+            "# TYPE ent_window_mean gauge\nent_window_mean %.6f\n"
+            "# TYPE ent_window_serial_correlation gauge\nent_window_serial_correlation %.6f\n"
+            "# TYPE ent_repetition_count_alarms_total counter\nent_repetition_count_alarms_total %llu\n"
+            "# TYPE ent_adaptive_proportion_alarms_total counter\nent_adaptive_proportion_alarms_total %llu\n"
+            "# TYPE ent_repetition_count_cutoff gauge\nent_repetition_count_cutoff %u\n"
+            "# TYPE ent_adaptive_proportion_cutoff gauge\nent_adaptive_proportion_cutoff %u\n",
+            (unsigned long long) samples, (unsigned long long) windowFill, get_entropy(), get_chisquare(), get_mean(), get_serial_correlation(),
+            (unsigned long long) repetitionAlarms, (unsigned long long) proportionAlarms, repetitionCutoff, proportionCutoff);
+        if (length < 0 || size_t(length) >= metricsText.size()) {
+            return false;
+        }
+        return replace_file(metricsPath, std::string_view(metricsText.data(), size_t(length)), metricsTemporary, false);
+    }
+
+public:
+    // minEntropy is the assessed min-entropy of the source in bits per byte, at most 8, which
+    // sets the health test cutoffs. A minEntropy that is not positive has no cutoffs: the
+    // health tests are off and both cutoffs read 0. Rolling statistics cover the last
+    // windowSize bytes.
+    Monitor(double minEntropy = 8.0, size_t windowSize = 1 << 20) : window(std::max<size_t>(2, windowSize)), windowSize(std::max<size_t>(2, windowSize)), windowStart(0), windowFill(0), histogram{}, productSum(0), samples(0), repetitionCutoff(0), repetitionValue(0), repetitionCount(0), repetitionAlarms(0), proportionCutoff(0), proportionValue(0), proportionCount(0), proportionSeen(0), proportionAlarms(0), metricsInterval(0), nextMetrics(0), metricsText{}, stopRequested(false) {
+        if (minEntropy > 0.0) {
+            minEntropy = std::min(minEntropy, 8.0);
+            double repetitions = std::ceil(HEALTH_FALSE_ALARM_BITS / minEntropy);
+            repetitionCutoff = 1 + unsigned(std::min(repetitions, double(UINT32_MAX - 1)));
+            proportionCutoff = 1 + critical_binomial(HEALTH_APT_WINDOW, std::exp2(-minEntropy));
+        }
+    }
+
+    // Called from the sample path as soon as a health test trips
+    void setAlarmCallback(std::function<void(const HealthAlarm &)> callback) {
+        alarmCallback = std::move(callback);
+    }
+
+    // Replaces path with the current metrics every intervalBytes of input, through path.tmp
+    // in the same directory. The metrics are written here once as well; returns false if
+    // that fails.
+    bool setMetricsFile(const std::string &path, uint64_t intervalBytes) {
+        metricsPath = path;
+        metricsTemporary = path + ".tmp";
+        metricsInterval = intervalBytes;
+        nextMetrics = samples + intervalBytes;
+        return export_metrics();
+    }
+
+    void update(std::span<const unsigned char> bytes) {
+        for (unsigned char byte : bytes) {
+            health_tests(byte);
+            roll_window(byte);
+            samples++;
+        }
+        if (metricsInterval > 0 && !metricsPath.empty() && samples >= nextMetrics) {
+            export_metrics();
+            nextMetrics = samples + metricsInterval;
+        }
+    }
+
+    // Feeds a stream such as /dev/urandom or a pipe until it ends or stop() is called.
+    // Returns false if the stream failed rather than ended.
+    bool run(std::istream &in, size_t chunkSize = 4096) {
+        std::vector<unsigned char> chunk(chunkSize);
+        while (!stopRequested && in) {
+            in.read(reinterpret_cast<char *>(chunk.data()), chunk.size());
+            update(std::span<const unsigned char>(chunk.data(), size_t(in.gcount())));
+        }
+        export_metrics();
+        return !in.bad();
+    }
+
+    bool runFile(const std::string &path, size_t chunkSize = 4096) {
+        std::ifstream file(path, std::ios::binary);
+        return file && run(file, chunkSize);
+    }
+
+    // Makes run() return after the current chunk, safe to call from another thread
+    void stop() {
+        stopRequested = true;
+    }
+
+    uint64_t get_samples() const {
+        return samples;
+    }
+    uint64_t get_repetition_alarms() const {
+        return repetitionAlarms;
+    }
+    uint64_t get_proportion_alarms() const {
+        return proportionAlarms;
+    }
+    unsigned get_repetition_cutoff() const {
+        return repetitionCutoff;
+    }
+    unsigned get_proportion_cutoff() const {
+        return proportionCutoff;
+    }
+    double get_entropy() const {
+        double entropy = 0.0;
+        for (auto count : histogram) {
+            if (count > 0) {
+                double frequency = count / double(windowFill);
+                entropy -= frequency * std::log2(frequency);
+            }
+        }
+        return entropy;
+    }
+    double get_chisquare() const {
+        double expected = windowFill / double(BYTE_VAL_COUNT);
+        double chisquare = 0.0;
+        for (auto count : histogram) {
+            double diff = count - expected;
+            chisquare += diff * diff / expected;
+        }
+        return chisquare;
+    }
+    double get_mean() const {
+        double sum = 0.0;
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            sum += double(value) * histogram[value];
+        }
+        return sum / windowFill;
+    }
+    double get_serial_correlation() const {
+        double sum = 0.0;
+        double sumSquares = 0.0;
+        for (int value = 0; value < BYTE_VAL_COUNT; ++value) {
+            sum += double(value) * histogram[value];
+            sumSquares += double(value) * value * histogram[value];
+        }
+        double first = window[windowStart];
+        double last = window[(windowStart + windowFill - 1) % windowSize];
+        double n = windowFill - 1.0;
+        double sumX = sum - last;
+        double sumY = sum - first;
+        double sumX2 = sumSquares - last * last;
+        double sumY2 = sumSquares - first * first;
+        return (n * productSum - sumX * sumY) / std::sqrt((n * sumX2 - sumX * sumX) * (n * sumY2 - sumY * sumY));
+    }
 };
 
+using Ent = BasicEnt<>;
+
 } // namespace Ent
@@ -0,0 +1,706 @@
+// ent_test - Checks that the states of random shard splits merge into exactly the result
+// of one pass, for the basic sums and every stream test, and checks the SP 800-22 tests
+// against the worked examples of the specification, which use the binary expansion of e.
+// Also checks the Monitor cutoffs against SP 800-90B, scanFile() on sparse files and from
+// checkpoints, and each optional statistic on data whose answer is known.
+//
+// Build and run: cmake -S . -B build && cmake --build build && ctest --test-dir build
+// or: clang++ -std=c++20 -O2 tests/ent_test.cpp -o ent_test
+//
+//   ent_test
+//       Runs all checks, prints the ones that fail and exits with status 1 if any did.
+#include "../ent.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+static void check(bool ok, const std::string &what) {
+    if (!ok) {
+        std::cerr << "FAIL: " << what << "\n";
+        failures++;
+    }
+}
+
+// Equal up to the rounding of sums taken in another order, NaN equal to NaN
+static bool same(double a, double b) {
+    if (std::isnan(a) || std::isnan(b)) {
+        return std::isnan(a) && std::isnan(b);
+    }
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(a));
+}
+
+// Every reported number of a result, in order
+static void add(std::vector<double> &out, const Ent::BitBatteryResult &r) {
+    out.insert(out.end(), {double(r.bits), r.frequency, r.blockFrequencyChisquare, r.blockFrequency, r.runs, r.longestRunChisquare, r.longestRun, r.cumulativeSumsForward, r.cumulativeSumsReverse});
+}
+static void add(std::vector<double> &out, const Ent::MatrixRankResult &r) {
+    out.insert(out.end(), {double(r.matrices32), r.chisquare32, r.p32, double(r.matrices64), r.chisquare64, r.p64});
+}
+static void add(std::vector<double> &out, const Ent::LinearComplexityResult &r) {
+    out.insert(out.end(), {double(r.blocks), double(r.blockBits), double(r.minimum), r.chisquare, r.p_value});
+}
+static void add(std::vector<double> &out, const Ent::UniversalResult &r) {
+    out.insert(out.end(), {double(r.blockBits), double(r.blocks), r.statistic, r.expected, r.p_value});
+}
+static void add(std::vector<double> &out, const Ent::PatternResult &r) {
+    out.insert(out.end(), {double(r.length), r.serialDelta, r.serialP, r.serialDelta2, r.serialP2, r.approximateEntropy, r.approximateEntropyP});
+}
+static void add(std::vector<double> &out, const Ent::KnuthResult &r) {
+    out.insert(out.end(), {double(r.symbolBits), double(r.hands), r.pokerChisquare, r.pokerP, double(r.gaps), r.gapChisquare, r.gapP, double(r.coupons), r.couponChisquare, r.couponP});
+}
+static void add(std::vector<double> &out, const Ent::BitPositionResult &r) {
+    out.insert(out.end(), {double(r.position), r.ones, r.chisquare, r.p_value, r.correlation});
+}
+static void add(std::vector<double> &out, const Ent::ColumnResult &r) {
+    out.insert(out.end(), {double(r.column), double(r.samples), r.entropy, r.chisquare, r.p_value, r.mean});
+}
+static void add(std::vector<double> &out, const Ent::FloatFieldResult &r) {
+    out.insert(out.end(), {double(r.bits), double(r.values), r.signEntropy, r.exponentEntropy, r.xorEntropy});
+    out.insert(out.end(), r.mantissaEntropy.begin(), r.mantissaEntropy.end());
+    out.insert(out.end(), r.xorByteEntropy.begin(), r.xorByteEntropy.end());
+}
+static void add(std::vector<double> &out, const Ent::TransformResult &r) {
+    out.insert(out.end(), {double(r.lag), double(r.samples), r.entropy, r.chisquare, r.p_value, r.mean});
+}
+template <typename T>
+static void add(std::vector<double> &out, const std::vector<T> &results) {
+    for (const T &r : results) {
+        add(out, r);
+    }
+}
+
+static std::vector<double> report(const Ent::State &state) {
+    std::vector<double> out = {double(state.get_length()), double(state.get_product_sum()), double(state.get_bit_changes()), double(state.get_first()), double(state.get_last()), double(state.get_pi_hits()), double(state.get_pi_total())};
+    out.insert(out.end(), state.get_histogram().begin(), state.get_histogram().end());
+    const Ent::StreamTests &tests = state.get_tests();
+    if (tests.battery) {
+        add(out, tests.battery->result());
+    }
+    if (tests.rank) {
+        add(out, tests.rank->result());
+    }
+    if (tests.linear) {
+        add(out, tests.linear->result());
+    }
+    if (tests.universal) {
+        add(out, tests.universal->result());
+    }
+    if (tests.patterns) {
+        add(out, tests.patterns->result());
+    }
+    if (tests.symbols) {
+        add(out, tests.symbols->result());
+    }
+    if (tests.positions) {
+        add(out, tests.positions->result());
+    }
+    if (tests.columns) {
+        add(out, tests.columns->result());
+    }
+    if (tests.floats) {
+        add(out, tests.floats->result());
+    }
+    if (tests.transforms) {
+        add(out, tests.transforms->result());
+    }
+    return out;
+}
+
+// Accumulates bytes as shards of random length, a third of them 1 to 5 bytes long, each
+// passed through serialization, and merges them in stream order. With continueCoupons each
+// shard takes over the coupon segments of the shards before it, as scanFile() does.
+static std::optional<Ent::State> merge_shards(const std::vector<unsigned char> &bytes, bool foldCase, const Ent::StreamTests &tests, bool continueCoupons, std::mt19937_64 &random) {
+    std::optional<Ent::State> merged;
+    for (size_t position = 0; position < bytes.size();) {
+        size_t size = random() % 3 == 0 ? 1 + random() % 5 : 1 + random() % 40000;
+        size = std::min(size, bytes.size() - position);
+        Ent::StreamTests shardTests = tests;
+        if (continueCoupons && merged && shardTests.symbols) {
+            shardTests.symbols->continue_coupons(*merged->get_tests().symbols);
+        }
+        Ent::State shard(position, foldCase, shardTests);
+        shard.update(std::span<const unsigned char>(bytes.data() + position, size));
+        std::stringstream image;
+        shard.serialize(image);
+        Ent::State loaded;
+        if (!loaded.deserialize(image)) {
+            return std::nullopt;
+        }
+        if (!merged) {
+            merged = loaded;
+        } else if (!merged->merge(loaded)) {
+            return std::nullopt;
+        }
+        position += size;
+    }
+    return merged;
+}
+
+static void check_merges() {
+    std::mt19937_64 random(1);
+    // Random bytes mixed with runs, repeats and letters of both cases
+    std::vector<unsigned char> bytes(300007);
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        switch (random() % 4) {
+        case 0:
+            bytes[i] = (unsigned char)random();
+            break;
+        case 1:
+            bytes[i] = (unsigned char)('A' + random() % 26 + (random() % 2) * 32);
+            break;
+        case 2:
+            bytes[i] = i > 0 ? bytes[i - 1] : 0;
+            break;
+        default:
+            bytes[i] = i >= 8 ? bytes[i - 8] : 0;
+        }
+    }
+
+    const char *names[] = {"basic sums", "bit battery", "matrix rank", "linear complexity", "universal", "patterns", "knuth", "bit positions", "columns", "float fields", "transforms", "all tests"};
+    for (int component = 0; component < 12; ++component) {
+        Ent::StreamTests tests;
+        bool all = component == 11;
+        if (component == 1 || all) {
+            tests.battery.emplace(192);
+        }
+        if (component == 2 || all) {
+            tests.rank.emplace();
+        }
+        if (component == 3 || all) {
+            tests.linear.emplace(256);
+        }
+        if (component == 4 || all) {
+            tests.universal.emplace(7);
+        }
+        if (component == 5 || all) {
+            tests.patterns.emplace(9);
+        }
+        if (component == 6 || all) {
+            tests.symbols.emplace(4);
+        }
+        if (component == 7 || all) {
+            tests.positions.emplace();
+        }
+        if (component == 8 || all) {
+            tests.columns.emplace(12);
+        }
+        if (component == 9 || all) {
+            tests.floats.emplace(64, Ent::Endian::Little);
+        }
+        if (component == 10 || all) {
+            tests.transforms.emplace(5);
+        }
+        for (bool foldCase : {false, true}) {
+            std::string what = std::string(names[component]) + (foldCase ? ", folded" : "");
+            Ent::State single(0, foldCase, tests);
+            single.update(bytes);
+            std::optional<Ent::State> merged = merge_shards(bytes, foldCase, tests, true, random);
+            check(merged.has_value(), what + ": shards do not merge");
+            if (!merged) {
+                continue;
+            }
+            std::vector<double> expected = report(single), actual = report(*merged);
+            bool equal = expected.size() == actual.size();
+            for (size_t k = 0; equal && k < expected.size(); ++k) {
+                equal = same(expected[k], actual[k]);
+            }
+            check(equal, what + ": merged shards differ from one pass");
+        }
+    }
+
+    // Shards that do not continue the coupon segments cannot know where theirs start
+    Ent::StreamTests tests;
+    tests.symbols.emplace(2);
+    std::optional<Ent::State> merged = merge_shards(bytes, false, tests, false, random);
+    check(merged && merged->get_tests().symbols->result().coupons == 0, "coupon collector test of independent shards is not undefined");
+    Ent::State single(0, false, tests);
+    single.update(bytes);
+    check(single.get_tests().symbols->result().coupons > 0, "coupon collector test of one pass is undefined");
+}
+
+// Generator output split over the workers analyzes as the outputs concatenated in one
+// pass, coupon segments included
+static void check_generator() {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t size = 1000003;
+    Ent::StreamTests tests;
+    tests.symbols.emplace(4);
+    uint64_t unit = tests.alignment();
+    uint64_t share = ((size + workers - 1) / workers + unit - 1) / unit * unit;
+    std::vector<unsigned char> bytes;
+    for (size_t w = 0; w < workers; ++w) {
+        std::mt19937 engine(5489u + w);
+        std::vector<unsigned char> output(std::min(size, (w + 1) * share) - std::min(size, w * share));
+        Ent::generate_bytes(engine, output.data(), output.size());
+        bytes.insert(bytes.end(), output.begin(), output.end());
+    }
+    Ent::State single(0, false, tests);
+    single.update(bytes);
+
+    Ent::Ent ent(std::span<const std::byte>{});
+    ent.setPrintResultMode(false);
+    ent.setTestMode(Ent::TEST_KNUTH, true);
+    ent.setKnuthSymbolBits(4);
+    uint64_t analyzed = ent.analyzeGenerator([](size_t index) { return std::mt19937(5489u + index); }, size);
+    check(analyzed == size, "generator analysis covers " + std::to_string(analyzed) + " bytes");
+    Ent::State state = ent.get_state();
+    check(state.get_tests().symbols->result().coupons > 0, "coupon collector test of generator output is undefined");
+    std::vector<double> expected = report(single), actual = report(state);
+    bool equal = expected.size() == actual.size();
+    for (size_t k = 0; equal && k < expected.size(); ++k) {
+        equal = same(expected[k], actual[k]);
+    }
+    check(equal, "generator analysis differs from one pass over the output");
+}
+
+// The first bytes of the binary expansion of e, "10" followed by the fraction, most
+// significant bit first. Horner's rule x = 1 + x / k runs from k = K down to 1 in fixed
+// point on 32-bit limbs, two divisors at a time while k (k - 1) fits in a limb. What is
+// left to divide x by is (k - 1)!, so limbs below the precision that leaves are skipped.
+static std::vector<unsigned char> e_bytes(size_t size) {
+    size_t limbs = size / 4 + 3;  // The integer part, the fraction and two guard limbs
+    double precision = 32.0 * limbs;
+    uint64_t k = 1;
+    double scale = 0;  // log2(k!)
+    while (scale < precision) {
+        scale += std::log2(double(++k));
+    }
+    std::vector<uint32_t> x(limbs, 0);
+    x[0] = 1;
+    auto step = [&](uint32_t add, uint64_t divisor) {
+        scale -= std::log2(double(divisor));
+        size_t used = std::min(limbs, size_t((precision - scale) / 32) + 2);
+        x[0] += add;
+        uint64_t remainder = 0;
+        for (size_t i = 0; i < used; ++i) {
+            uint64_t value = remainder << 32 | x[i];
+            x[i] = uint32_t(value / divisor);
+            remainder = value % divisor;
+        }
+    };
+    for (; k > UINT16_MAX; --k) {
+        step(uint32_t(k), k);
+    }
+    // 1 + (1 + x / k) / (k - 1) in one division
+    for (; k >= 2; k -= 2) {
+        step(uint32_t(k * k), k * (k - 1));
+    }
+    if (k == 1) {
+        step(1, 1);
+    }
+    std::vector<unsigned char> bytes(size);
+    for (size_t i = 0; i < 8 * size; ++i) {
+        int bit = i < 2 ? int(x[0] >> (1 - i)) & 1 : int(x[1 + (i - 2) / 32] >> (31 - (i - 2) % 32)) & 1;
+        bytes[i / 8] |= bit << (7 - i % 8);
+    }
+    return bytes;
+}
+static void check_value(double actual, double expected, const std::string &what) {
+    check(std::fabs(actual - expected) <= 1.5e-6, what + " is " + std::to_string(actual) + ", expected " + std::to_string(expected));
+}
+
+// Examples of SP 800-22 rev. 1a, sections 2 and Appendix B, on the first 10^5 and 10^6 bits of e
+static void check_sp800_22() {
+    std::vector<unsigned char> e = e_bytes(125000);
+
+    Ent::MatrixRank rank;
+    rank.update(e.data(), 12500);
+    Ent::MatrixRankResult ranks = rank.result();
+    check(ranks.matrices32 == 97, "rank test of 10^5 bits uses " + std::to_string(ranks.matrices32) + " matrices, expected 97");
+    check_value(ranks.chisquare32, 1.2619656, "rank chi-square of 10^5 bits");
+    check_value(ranks.p32, 0.532069, "rank p-value of 10^5 bits");
+
+    Ent::MatrixRank fullRank;
+    fullRank.update(e.data(), e.size());
+    check_value(fullRank.result().p32, 0.306156, "rank p-value");
+
+    Ent::BitBattery battery(128);
+    battery.update(e.data(), e.size());
+    Ent::BitBatteryResult bits = battery.result();
+    check_value(bits.frequency, 0.953749, "frequency p-value");
+    check_value(bits.blockFrequency, 0.211072, "block frequency p-value");
+    check_value(bits.runs, 0.561917, "runs p-value");
+    check_value(bits.cumulativeSumsForward, 0.669887, "forward cumulative sums p-value");
+    check_value(bits.cumulativeSumsReverse, 0.724266, "reverse cumulative sums p-value");
+
+    Ent::Universal universal(7);
+    universal.update(e.data(), e.size(), 0);
+    check_value(universal.result().p_value, 0.282568, "universal p-value");
+
+    // Section 2.10.8 counts 11, 31, 116, 501, 258, 57 and 26 blocks of M = 1000 bits in the
+    // seven complexity classes. Its chi-square of 2.700348 rounds pi_0 to 0.01047, so the
+    // expected value follows from the counts and the class probabilities of the test.
+    Ent::LinearComplexity linear(1000);
+    linear.update(e.data(), e.size());
+    Ent::LinearComplexityResult complexity = linear.result();
+    const double counts[] = {11, 31, 116, 501, 258, 57, 26};
+    const double probabilities[] = {0.010417, 0.03125, 0.125, 0.5, 0.25, 0.0625, 0.020833};
+    double chisquare = 0.0;
+    for (int i = 0; i < 7; ++i) {
+        double expected = 1000 * probabilities[i];
+        chisquare += (counts[i] - expected) * (counts[i] - expected) / expected;
+    }
+    double half = chisquare / 2;  // igamc(3, half) in closed form for 6 degrees of freedom
+    check(complexity.blocks == 1000, "linear complexity test uses " + std::to_string(complexity.blocks) + " blocks, expected 1000");
+    check_value(complexity.chisquare, chisquare, "linear complexity chi-square");
+    check_value(complexity.p_value, std::exp(-half) * (1 + half + half * half / 2), "linear complexity p-value");
+
+    Ent::Patterns patterns(16);
+    patterns.update(e.data(), e.size());
+    for (const Ent::PatternResult &serial : patterns.result()) {
+        if (serial.length == 2) {
+            check_value(serial.serialP, 0.843764, "serial p-value 1 for m = 2");
+            check_value(serial.serialP2, 0.561915, "serial p-value 2 for m = 2");
+        } else if (serial.length == 10) {
+            check_value(serial.approximateEntropyP, 0.700073, "approximate entropy p-value for m = 10");
+        } else if (serial.length == 16) {
+            check_value(serial.serialP, 0.766182, "serial p-value 1 for m = 16");
+            check_value(serial.serialP2, 0.462921, "serial p-value 2 for m = 16");
+        }
+    }
+}
+
+static std::vector<unsigned char> random_bytes(size_t size, unsigned seed) {
+    std::mt19937 engine(seed);
+    std::vector<unsigned char> bytes(size);
+    Ent::generate_bytes(engine, bytes.data(), bytes.size());
+    return bytes;
+}
+
+static std::span<const std::byte> as_input(const std::vector<unsigned char> &bytes) {
+    return std::as_bytes(std::span<const unsigned char>(bytes));
+}
+
+static bool same_report(const Ent::State &a, const Ent::State &b) {
+    std::vector<double> expected = report(a), actual = report(b);
+    bool equal = expected.size() == actual.size();
+    for (size_t k = 0; equal && k < expected.size(); ++k) {
+        equal = same(expected[k], actual[k]);
+    }
+    return equal;
+}
+
+// The LZ estimate compresses a run of zeros almost completely and random bytes not at all,
+// sees folded letters as folded, and is undefined without bytes in memory
+static void check_lz() {
+    auto estimate = [](const std::vector<unsigned char> &bytes, bool foldCase) {
+        Ent::Ent ent(as_input(bytes));
+        ent.setPrintResultMode(false);
+        ent.setTestMask(Ent::TEST_LZ);
+        ent.setFoldCaseMode(foldCase);
+        ent.calculate();
+        return std::pair(ent.get_lz_size(), ent.get_lz_compression());
+    };
+    std::vector<unsigned char> zeros(1 << 20, 0), noise = random_bytes(1 << 20, 1);
+    check(estimate(zeros, false).second > 99.0, "LZ estimate compresses zeros by " + std::to_string(estimate(zeros, false).second) + "%");
+    check(estimate(noise, false).second == 0.0, "LZ estimate compresses random bytes by " + std::to_string(estimate(noise, false).second) + "%");
+
+    std::vector<unsigned char> upper(1 << 18), lower(upper.size());
+    for (size_t i = 0; i < upper.size(); ++i) {
+        upper[i] = (unsigned char)('A' + noise[i] % 26);
+        lower[i] = (unsigned char)(upper[i] - 'A' + 'a');
+    }
+    check(estimate(upper, true).first == estimate(lower, false).first, "LZ estimate of folded text differs from the lower case text");
+
+    Ent::Ent loaded(std::span<const std::byte>{});
+    loaded.setPrintResultMode(false);
+    loaded.setTestMask(Ent::TEST_LZ);
+    Ent::State state(0, false, Ent::StreamTests());
+    state.update(noise);
+    loaded.setState(state);
+    loaded.calculate();
+    check(std::isnan(loaded.get_lz_size()) && std::isnan(loaded.get_lz_compression()), "LZ estimate of a loaded state is not undefined");
+}
+
+// Compiled-in test sets, lazy getters, case folding and the span input report what a full
+// analysis of the same bytes does
+static void check_input() {
+    std::vector<unsigned char> text(100003);
+    std::mt19937 random(2);
+    for (auto &byte : text) {
+        byte = (unsigned char)(random() % 4 == 0 ? ' ' : 'A' + random() % 26 + (random() % 2) * 32);
+    }
+    std::vector<unsigned char> lower = text, original = text;
+    for (auto &byte : lower) {
+        byte = Ent::fold_table()[byte];
+    }
+
+    Ent::Ent full(as_input(lower));
+    full.setPrintResultMode(false);
+    full.calculate();
+
+    Ent::BasicEnt<Ent::Options<Ent::TEST_ENTROPY | Ent::TEST_CHISQUARE>> partial(as_input(lower));
+    partial.setPrintResultMode(false);
+    partial.calculate();
+    check(same(partial.get_entropy(), full.get_entropy()) && same(partial.get_chisquare(), full.get_chisquare()), "policy with entropy and chi-square compiled in differs from the full analysis");
+
+    Ent::Ent lazy(as_input(lower));
+    lazy.setLazyMode(true);
+    check(same(lazy.get_serial_correlation(), full.get_serial_correlation()) && same(lazy.get_pi_estimate(), full.get_pi_estimate()), "lazy getters differ from calculate()");
+
+    Ent::Ent folded(as_input(text));
+    folded.setPrintResultMode(false);
+    folded.setFoldCaseMode(true);
+    folded.calculate();
+    check(same_report(folded.get_state(), full.get_state()) && same(folded.get_entropy(), full.get_entropy()), "folded text differs from the lower case text");
+    check(text == original, "case folding changed the input buffer");
+
+    Ent::Ent replaced(as_input(text));
+    replaced.setPrintResultMode(false);
+    replaced.setData(std::string_view(reinterpret_cast<const char *>(lower.data()), lower.size()));
+    replaced.calculate();
+    check(same(replaced.get_entropy(), full.get_entropy()) && same(replaced.get_mean(), full.get_mean()), "setData() does not replace the data");
+}
+
+// Bytes analyzed as a stream of bits, and symbols wider and narrower than a byte
+static void check_symbols() {
+    std::vector<unsigned char> alternating(4096, 0x55);
+    Ent::Ent bits(as_input(alternating));
+    bits.setPrintResultMode(false);
+    bits.setStreamOfBitsMode(true);
+    bits.calculate();
+    check_value(bits.get_entropy(), 1.0, "entropy of alternating bits");
+    check_value(bits.get_mean(), 0.5, "mean of alternating bits");
+    check_value(bits.get_serial_correlation(), -1.0, "serial correlation of alternating bits");
+
+    std::vector<unsigned char> words(2 << 16);
+    for (size_t value = 0; value < (1 << 16); ++value) {
+        words[2 * value] = (unsigned char)(value >> 8);
+        words[2 * value + 1] = (unsigned char)value;
+    }
+    Ent::BasicEnt<Ent::Options<Ent::TEST_ALL, Ent::Sampling::Runtime, 16>> wide(as_input(words));
+    wide.setPrintResultMode(false);
+    wide.calculate();
+    check_value(wide.get_entropy(), 16.0, "entropy of every 16-bit symbol once");
+    check_value(wide.get_chisquare(), 0.0, "chi-square of every 16-bit symbol once");
+    check_value(wide.get_mean(), 32767.5, "mean of every 16-bit symbol once");
+
+    std::vector<unsigned char> values(256);
+    std::iota(values.begin(), values.end(), 0);
+    Ent::BasicEnt<Ent::Options<Ent::TEST_ALL, Ent::Sampling::Runtime, 4>> nibbles(as_input(values));
+    nibbles.setPrintResultMode(false);
+    nibbles.calculate();
+    check_value(nibbles.get_entropy(), 4.0, "entropy of the nibbles of every byte value");
+    check_value(nibbles.get_mean(), 7.5, "mean of the nibbles of every byte value");
+}
+
+// The optional statistics tell data with a structure from random bytes
+static void check_statistics() {
+    std::vector<unsigned char> noise = random_bytes(1 << 20, 3), periodic(1 << 20);
+    for (size_t i = 0; i < periodic.size(); ++i) {
+        periodic[i] = noise[i % 4];
+    }
+    auto analyze = [](Ent::Ent &ent) {
+        ent.setPrintResultMode(false);
+        ent.setTestMask(Ent::TEST_AUTOCORRELATION | Ent::TEST_SPECTRAL | Ent::TEST_BIRTHDAY | Ent::TEST_TRANSFORMS);
+        ent.setAutocorrelationLags(8);
+        ent.setTransformLag(4);
+        ent.calculate();
+    };
+    Ent::Ent structured(as_input(periodic)), random(as_input(noise));
+    analyze(structured);
+    analyze(random);
+    check(structured.get_strongest_lags(1) == std::vector<size_t>{4}, "strongest autocorrelation of a period of 4 bytes is not at lag 4");
+    check(structured.get_autocorrelation()[3] > 0.999 && std::fabs(random.get_autocorrelation()[3]) < 0.01, "autocorrelation at lag 4");
+    check(structured.get_spectral().p_value < 1e-6 && random.get_spectral().p_value > 0.001, "spectral test of periodic and random bytes");
+    check(structured.get_birthday().p_value < 1e-6 && random.get_birthday().p_value > 0.001, "birthday spacings of periodic and random bytes");
+    for (const Ent::TransformResult &transform : structured.get_transforms()) {
+        if (transform.name == "xor" && transform.lag == 4) {
+            check_value(transform.entropy, 0.0, "entropy of a period of 4 bytes XOR the bytes 4 back");
+        }
+    }
+
+    std::vector<unsigned char> counter(1 << 16);
+    for (size_t i = 0; i < counter.size(); ++i) {
+        counter[i] = (unsigned char)i;
+    }
+    Ent::Ent increments(as_input(counter));
+    increments.setPrintResultMode(false);
+    increments.setTestMask(Ent::TEST_TRANSFORMS);
+    increments.calculate();
+    Ent::TransformResult delta = increments.get_transforms().at(0);
+    check(delta.name == "delta", "first transform is " + delta.name + ", expected delta");
+    check_value(delta.entropy, 0.0, "delta entropy of incrementing bytes");
+    check_value(delta.mean, 1.0, "delta mean of incrementing bytes");
+
+    // Records of a constant, a random, a constant odd byte and the sign byte of a float
+    // that is +1 or -1 at random
+    std::vector<unsigned char> records(noise.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        switch (i % 4) {
+        case 0:
+            records[i] = 0x20;
+            break;
+        case 1:
+            records[i] = noise[i];
+            break;
+        case 2:
+            records[i] = 0x81;
+            break;
+        default:
+            records[i] = (unsigned char)(0x3f | (noise[i] & 0x80));
+        }
+    }
+    Ent::Ent fields(as_input(records));
+    fields.setPrintResultMode(false);
+    fields.setTestMask(Ent::TEST_BIT_POSITIONS | Ent::TEST_COLUMNS | Ent::TEST_FLOAT_FIELDS);
+    fields.setRecordSize(4);
+    fields.setFloatBits(32);
+    fields.calculate();
+    std::vector<Ent::ColumnResult> columns = fields.get_columns();
+    check(columns.size() == 4, "columns of records of 4 bytes");
+    if (columns.size() == 4) {
+        check_value(columns[0].entropy, 0.0, "entropy of a constant column");
+        check_value(columns[0].mean, 0x20, "mean of a constant column");
+        check(columns[1].entropy > 7.9, "entropy of a random column is " + std::to_string(columns[1].entropy));
+    }
+    std::vector<Ent::BitPositionResult> positions = fields.get_bit_positions();
+    check(positions.size() == 8, "bit positions of bytes");
+    for (uint32_t bit = 0; bit < positions.size(); ++bit) {
+        double ones = 0;
+        for (unsigned char byte : records) {
+            ones += (byte >> bit) & 1;
+        }
+        check(positions[bit].position == bit, "bit position " + std::to_string(bit) + " out of order");
+        check_value(positions[bit].ones, ones / records.size(), "ones of bit position " + std::to_string(bit));
+    }
+    Ent::FloatFieldResult floats = fields.get_float_fields();
+    check(floats.values == records.size() / 4, "float values of records of 4 bytes");
+    check(floats.signEntropy > 0.99, "sign entropy of floats of random sign is " + std::to_string(floats.signEntropy));
+}
+
+// SP 800-90B section 4.4 cutoffs for a window of 512 non-binary samples at a false alarm
+// probability of 2^-20, and alarms raised on the sample that reaches a cutoff
+static void check_monitor() {
+    const double entropies[] = {0.5, 1, 2, 4, 8};
+    const unsigned repetitions[] = {41, 21, 11, 6, 4};
+    const unsigned proportions[] = {410, 311, 177, 62, 13};
+    for (int i = 0; i < 5; ++i) {
+        Ent::Monitor monitor(entropies[i]);
+        std::string what = " cutoff for H = " + std::to_string(entropies[i]);
+        check(monitor.get_repetition_cutoff() == repetitions[i], "repetition count" + what + " is " + std::to_string(monitor.get_repetition_cutoff()));
+        check(monitor.get_proportion_cutoff() == proportions[i], "adaptive proportion" + what + " is " + std::to_string(monitor.get_proportion_cutoff()));
+    }
+
+    std::vector<Ent::HealthAlarm> alarms;
+    Ent::Monitor repetition(8.0);
+    repetition.setAlarmCallback([&](const Ent::HealthAlarm &alarm) { alarms.push_back(alarm); });
+    repetition.update(std::vector<unsigned char>(3, 7));
+    check(alarms.empty(), "3 repeated bytes trip the repetition count test");
+    repetition.update(std::vector<unsigned char>{7});
+    check(alarms.size() == 1 && alarms[0].test == Ent::HealthAlarm::REPETITION_COUNT && alarms[0].offset == 3, "4 repeated bytes do not trip the repetition count test");
+
+    // The first byte of the window every other byte, the 13th time at offset 24
+    alarms.clear();
+    Ent::Monitor proportion(8.0);
+    proportion.setAlarmCallback([&](const Ent::HealthAlarm &alarm) { alarms.push_back(alarm); });
+    std::vector<unsigned char> samples(25);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = i % 2 == 0 ? 7 : (unsigned char)(100 + i);
+    }
+    proportion.update(std::span<const unsigned char>(samples.data(), 24));
+    check(alarms.empty(), "12 of 24 bytes trip the adaptive proportion test");
+    proportion.update(std::span<const unsigned char>(samples.data() + 24, 1));
+    check(alarms.size() == 1 && alarms[0].test == Ent::HealthAlarm::ADAPTIVE_PROPORTION && alarms[0].offset == 24, "13 of 25 bytes do not trip the adaptive proportion test");
+    check(proportion.get_repetition_alarms() == 0 && proportion.get_proportion_alarms() == 1, "alarm counts of the adaptive proportion test");
+
+    Ent::Monitor off(0.0);
+    check(off.get_repetition_cutoff() == 0 && off.get_proportion_cutoff() == 0, "cutoffs without a min-entropy");
+}
+
+// scanFile() of a file with a hole in the middle reports what the bytes in memory do, a
+// scan resumed from a checkpoint continues it, and a checkpoint of the file before it
+// changed is rejected
+static void check_scan() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::string path = (directory / "ent_test_scan.bin").string();
+    std::string checkpoint = (directory / "ent_test_scan.state").string();
+    std::filesystem::remove(checkpoint);
+
+    std::vector<unsigned char> bytes(5 << 20, 0), noise = random_bytes(1 << 20, 4);
+    std::copy(noise.begin(), noise.end(), bytes.begin());
+    std::copy(noise.begin(), noise.end(), bytes.end() - noise.size());
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(noise.data()), noise.size());
+    }
+    std::filesystem::resize_file(path, bytes.size() - noise.size());
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.write(reinterpret_cast<const char *>(noise.data()), noise.size());
+    }
+
+    // Only the basic sums take the holes in closed form
+    const unsigned basic = Ent::TEST_ENTROPY | Ent::TEST_CHISQUARE | Ent::TEST_MEAN | Ent::TEST_PI | Ent::TEST_SERIAL_CORRELATION;
+    for (unsigned mask : {basic, basic | Ent::TEST_BIT_BATTERY | Ent::TEST_KNUTH | Ent::TEST_TRANSFORMS}) {
+        auto configure = [&](Ent::Ent &ent) {
+            ent.setPrintResultMode(false);
+            ent.setTestMask(mask);
+            ent.setKnuthSymbolBits(4);
+        };
+        std::string what = mask == basic ? "" : " with stream tests";
+        Ent::Ent memory(as_input(bytes));
+        configure(memory);
+        Ent::Ent scan(std::span<const std::byte>{});
+        configure(scan);
+        check(scan.scanFile(path), "scan of a sparse file fails" + what);
+        check(same_report(scan.get_state(), memory.get_state()), "scan of a sparse file differs from the bytes in memory" + what);
+
+        // A checkpoint of the first 2 MiB, as an interrupted scan leaves it
+        auto save_prefix = [&](const std::vector<unsigned char> &prefix) {
+            Ent::Ent first(std::as_bytes(std::span<const unsigned char>(prefix.data(), 2 << 20)));
+            configure(first);
+            Ent::State state = first.get_state();
+            auto modified = std::filesystem::last_write_time(path);
+            state.set_source(Ent::SourceIdentity{bytes.size(), int64_t(modified.time_since_epoch().count())});
+            return state.save(checkpoint);
+        };
+        check(save_prefix(bytes), "checkpoint cannot be saved");
+        Ent::Ent resumed(std::span<const std::byte>{});
+        configure(resumed);
+        resumed.setCheckpointFile(checkpoint, 1 << 20);
+        resumed.setResumeMode(true);
+        check(resumed.scanFile(path) && same_report(resumed.get_state(), memory.get_state()), "resumed scan differs from one scan" + what);
+
+        // Resuming really starts from the checkpoint
+        check(save_prefix(std::vector<unsigned char>(bytes.size(), 0)), "checkpoint cannot be saved");
+        check(resumed.scanFile(path) && !same_report(resumed.get_state(), memory.get_state()), "resumed scan ignores the checkpoint" + what);
+        std::filesystem::remove(checkpoint);
+    }
+
+    Ent::Ent scan(std::span<const std::byte>{});
+    scan.setPrintResultMode(false);
+    scan.setCheckpointFile(checkpoint, 1 << 20);
+    scan.setResumeMode(true);
+    check(scan.scanFile(path), "checkpointed scan fails");
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::app);
+        file.put(0);
+    }
+    check(!scan.scanFile(path), "scan resumes from the checkpoint of the file before it changed");
+    std::filesystem::remove(checkpoint);
+    std::filesystem::remove(path);
+}
+
+int main() {
+    check_merges();
+    check_generator();
+    check_sp800_22();
+    check_lz();
+    check_input();
+    check_symbols();
+    check_statistics();
+    check_monitor();
+    check_scan();
+    if (failures > 0) {
+        std::cerr << failures << " checks failed\n";
+        return 1;
+    }
+    std::cout << "All checks passed\n";
+    return 0;
+}
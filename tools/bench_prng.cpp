@@ -0,0 +1,79 @@
+// bench_prng - Runs the Ent statistics over std:: random engines in process, without
+// writing their output to disk, and reports how fast each generator is.
+//
+// Compile: clang++ -std=c++20 -O2 tools/bench_prng.cpp -o bench-prng
+//
+//   bench-prng [megabytes]    (default 256)
+#include "../ent.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <string>
+
+// Generator only throughput, one engine per core as in analyzeGenerator()
+template <typename Engine>
+static double generator_gbps(uint64_t byteCount) {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t share = (byteCount + workers - 1) / workers;
+    std::atomic<unsigned> checksum(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; ++w) {
+        threads.emplace_back([&, w]() {
+            Engine engine(5489u + w);
+            std::vector<unsigned char> chunk(GENERATOR_CHUNK_SIZE);
+            // Exactly byteCount bytes in total, the last chunk of a share cut short
+            uint64_t size = std::min(byteCount, (w + 1) * share) - std::min(byteCount, w * share);
+            for (uint64_t done = 0; done < size; done += chunk.size()) {
+                Ent::generate_bytes(engine, chunk.data(), std::min<uint64_t>(chunk.size(), size - done));
+                checksum ^= chunk[0];  // Keeps the generation from being optimized away
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return byteCount / elapsed.count() / 1e9;
+}
+
+template <typename Engine>
+static void bench(const std::string &name, uint64_t byteCount) {
+    Ent::Ent ent(std::span<const std::byte>{});
+    ent.setPrintResultMode(false);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t analyzed = ent.analyzeGenerator([](size_t index) { return Engine(5489u + index); }, byteCount);
+    ent.calculate();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed
+              << std::setw(9) << std::setprecision(2) << generator_gbps<Engine>(byteCount)
+              << std::setw(9) << std::setprecision(2) << analyzed / elapsed.count() / 1e9
+              << std::setw(11) << std::setprecision(6) << ent.get_entropy()
+              << std::setw(13) << std::setprecision(2) << ent.get_chisquare()
+              << std::setw(9) << std::setprecision(4) << ent.get_p_value()
+              << std::setw(12) << std::setprecision(4) << ent.get_mean()
+              << std::setw(10) << std::setprecision(6) << ent.get_pi_estimate()
+              << std::setw(12) << std::setprecision(6) << ent.get_serial_correlation() << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t byteCount = (argc > 1 ? std::stoull(argv[1]) : 256) << 20;
+
+    std::cout << std::left << std::setw(22) << "generator" << std::right
+              << std::setw(9) << "gen GB/s" << std::setw(9) << "ent GB/s" << std::setw(11) << "entropy"
+              << std::setw(13) << "chi-square" << std::setw(9) << "p" << std::setw(12) << "mean"
+              << std::setw(10) << "pi" << std::setw(12) << "serial" << "\n";
+    bench<std::minstd_rand0>("minstd_rand0", byteCount);
+    bench<std::minstd_rand>("minstd_rand", byteCount);
+    bench<std::mt19937>("mt19937", byteCount);
+    bench<std::mt19937_64>("mt19937_64", byteCount);
+    bench<std::ranlux24_base>("ranlux24_base", byteCount);
+    bench<std::ranlux48_base>("ranlux48_base", byteCount);
+    bench<std::ranlux24>("ranlux24", byteCount);
+    bench<std::ranlux48>("ranlux48", byteCount);
+    bench<std::knuth_b>("knuth_b", byteCount);
+    return 0;
+}
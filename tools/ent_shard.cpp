@@ -0,0 +1,182 @@
+// ent_shard - Analyze shards of one logical stream separately and merge the results.
+//
+// Compile: clang++ -std=c++20 tools/ent_shard.cpp -o ent_shard
+//
+//   ent_shard scan <file> <offset> <length> <shard.state> [-c] [-n] [-r] [-l] [-u] [-s] [-k] [-p] [-w size] [-f 32|64] [-x lag]
+//       Accumulates bytes [offset, offset + length) of file into a shard state file.
+//   ent_shard merge [-b] [-t] <shard.state>...
+//       Merges adjacent shard states, in stream order, and prints the Ent report.
+//
+// -c folds upper case letters to lower case, -n adds the bit tests, -r the binary matrix
+// rank test, -l the linear complexity test, -u Maurer's universal test with L chosen for
+// the whole file, -s the serial and approximate entropy tests, -k the poker and gap tests
+// on bytes, -p the bias of each bit position, -w the statistics of each column of records of
+// size bytes, -f the field entropies of little endian float32 or float64 values, -x the byte
+// delta and XOR transforms with the XOR lag given, -b reports bits, -t prints terse CSV.
+// Tests carried by the shards are reported after merging.
+#include "../ent.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <string>
+
+static int usage() {
+    std::cerr << "usage: ent_shard scan <file> <offset> <length> <shard.state> [-c] [-n] [-r] [-l] [-u] [-s] [-k] [-p] [-w size] [-f 32|64] [-x lag]\n";
+    std::cerr << "       ent_shard merge [-b] [-t] <shard.state>...\n";
+    return 2;
+}
+
+// Reads a decimal count, rejecting signs, trailing characters and overflow
+static bool parse_count(const char *text, uint64_t &value) {
+    const char *end = text + std::strlen(text);
+    auto [last, error] = std::from_chars(text, end, value);
+    return error == std::errc() && last == end && last != text;
+}
+
+static int scan(int argc, char *argv[]) {
+    if (argc < 6) {
+        return usage();
+    }
+    uint64_t offset;
+    uint64_t length;
+    if (!parse_count(argv[3], offset) || !parse_count(argv[4], length)) {
+        std::cerr << "ent_shard: offset and length are decimal byte counts\n";
+        return usage();
+    }
+    bool foldCase = false;
+    bool universal = false;
+    Ent::StreamTests tests;
+    for (int i = 6; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-c") {
+            foldCase = true;
+        } else if (arg == "-n") {
+            tests.battery.emplace();
+        } else if (arg == "-r") {
+            tests.rank.emplace();
+        } else if (arg == "-l") {
+            tests.linear.emplace();
+        } else if (arg == "-s") {
+            tests.patterns.emplace();
+        } else if (arg == "-k") {
+            tests.symbols.emplace();
+        } else if (arg == "-p") {
+            tests.positions.emplace();
+        } else if ((arg == "-w" || arg == "-f" || arg == "-x") && i + 1 < argc) {
+            uint64_t value;
+            if (!parse_count(argv[++i], value) || value > UINT32_MAX) {
+                std::cerr << "ent_shard: " << arg << " takes a decimal count\n";
+                return usage();
+            }
+            if (arg == "-w") {
+                tests.columns.emplace(uint32_t(value));
+            } else if (arg == "-f") {
+                tests.floats.emplace(uint32_t(value));
+            } else {
+                tests.transforms.emplace(uint32_t(value));
+            }
+        } else if (arg == "-u") {
+            universal = true;
+        } else {
+            return usage();
+        }
+    }
+
+    std::ifstream file(argv[2], std::ios::binary);
+    if (!file) {
+        std::cerr << "ent_shard: cannot open " << argv[2] << "\n";
+        return 1;
+    }
+    if (!file.seekg(offset)) {
+        std::cerr << "ent_shard: cannot seek to " << offset << " in " << argv[2] << "\n";
+        return 1;
+    }
+    if (universal) {
+        // Without a size, as for a pipe, the file is taken to end with this shard
+        std::error_code error;
+        uint64_t fileSize = std::filesystem::file_size(argv[2], error);
+        tests.universal.emplace(Ent::Universal::block_bits_for(8 * (error ? offset + length : fileSize)));
+    }
+
+    Ent::State state(offset, foldCase, tests);
+    std::vector<unsigned char> chunk(1 << 20);
+    uint64_t remaining = length;
+    while (remaining > 0 && file) {
+        file.read(reinterpret_cast<char *>(chunk.data()), std::min<uint64_t>(chunk.size(), remaining));
+        size_t got = file.gcount();
+        state.update(std::span<const unsigned char>(chunk.data(), got));
+        remaining -= got;
+    }
+    if (remaining > 0) {
+        std::cerr << "ent_shard: " << argv[2] << " ends " << remaining << " bytes before offset " << offset + length << "\n";
+        return 1;
+    }
+
+    std::ofstream out(argv[5], std::ios::binary);
+    state.serialize(out);
+    if (!out) {
+        std::cerr << "ent_shard: cannot write " << argv[5] << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+static int merge(int argc, char *argv[]) {
+    bool bits = false;
+    bool terse = false;
+    std::optional<Ent::State> merged;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-b") {
+            bits = true;
+            continue;
+        }
+        if (arg == "-t") {
+            terse = true;
+            continue;
+        }
+        std::ifstream in(arg, std::ios::binary);
+        Ent::State state;
+        if (!state.deserialize(in)) {
+            std::cerr << "ent_shard: " << arg << " is not a shard state of version " << Ent::State::VERSION << "\n";
+            return 1;
+        }
+        if (!merged) {
+            merged = state;
+        } else if (!merged->merge(state)) {
+            std::cerr << "ent_shard: " << arg << " does not directly follow the previous shards\n";
+            return 1;
+        }
+    }
+    if (!merged) {
+        return usage();
+    }
+
+    Ent::Ent ent(std::span<const std::byte>{});
+    ent.setState(*merged);
+    // The results come from the state, only the tests the shards carry need selecting
+    unsigned carried = merged->get_tests().mask();
+    for (unsigned test = 1; test <= Ent::TEST_ALL; test <<= 1) {
+        if (carried & test) {
+            ent.setTestMode(Ent::Tests(test), true);
+        }
+    }
+    ent.setStreamOfBitsMode(bits);
+    ent.setTerseMode(terse);
+    ent.calculate();
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        return usage();
+    }
+    std::string mode = argv[1];
+    if (mode == "scan") {
+        return scan(argc, argv);
+    }
+    if (mode == "merge") {
+        return merge(argc, argv);
+    }
+    return usage();
+}